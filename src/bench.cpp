@@ -0,0 +1,445 @@
+// Binning throughput benchmark. Bins synthetic scenes of varying size, bbox
+// size distribution and overlap on the GPU and with the CPU reference,
+// radix sorts one bin key per path on the GPU, and prints one JSON document
+// with per-phase latency percentiles.
+//
+//   binning_bench [--backend=vulkan|swiftshader|null] [--mode=atomic|subgroup|bitmap]
+//                 [--paths=1000,10000,...] [--iterations=N] [--out=FILE]
+//                 [--workgroup-size=N] [--tile-size=N] [--auto-tune] [--compact] [--no-subgroups]
+//                 [--encoder-threads=N] [--cull]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lib.h"
+#include "util.h"
+#include "cpu_binner.h"
+#include "path_encoder.h"
+
+using namespace DawnAndroid;
+using Clock = std::chrono::steady_clock;
+
+static const uint32_t kWidth = 1080;
+static const uint32_t kHeight = 2400;
+
+// "degenerate" mixes full screen paths and inverted boxes (l > r or t > b),
+// which bin to nothing, into the mixed distribution.
+static const char *kSizeDistributions[] = {"small", "medium", "large", "mixed", "degenerate"};
+static const char *kOverlapPatterns[] = {"uniform", "clustered", "stacked"};
+
+static bool ParseFlag(const char *arg, const char *name, const char **value)
+{
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+    {
+        return false;
+    }
+    *value = arg + length + 1;
+    return true;
+}
+
+static double MillisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Bounding box extent in tiles.
+static uint32_t PathExtent(const char *sizes, std::mt19937 &rng, uint32_t maxExtent)
+{
+    auto range = [&rng](uint32_t lo, uint32_t hi)
+    { return std::uniform_int_distribution<uint32_t>(lo, std::max(lo, hi))(rng); };
+
+    if (strcmp(sizes, "small") == 0)
+    {
+        return range(1, 4);
+    }
+    if (strcmp(sizes, "medium") == 0)
+    {
+        return range(4, 64);
+    }
+    if (strcmp(sizes, "large") == 0)
+    {
+        return range(64, maxExtent);
+    }
+    // mixed and degenerate: mostly small with a long tail.
+    uint32_t roll = range(0, 99);
+    return roll < 80 ? range(1, 4) : roll < 95 ? range(4, 64) : range(64, maxExtent);
+}
+
+static std::vector<PathInfo> GenerateScene(uint32_t pathCount, const char *sizes, const char *overlap, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    uint32_t widthInTiles = DivUp(kWidth, kTileSize);
+    uint32_t heightInTiles = DivUp(kHeight, kTileSize);
+    uint32_t maxExtent = std::max(widthInTiles, heightInTiles);
+
+    std::vector<std::pair<float, float>> clusters;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        clusters.push_back({std::uniform_real_distribution<float>(0, widthInTiles)(rng),
+                            std::uniform_real_distribution<float>(0, heightInTiles)(rng)});
+    }
+    std::normal_distribution<float> spread(0, widthInTiles / 16.0f);
+
+    std::vector<PathInfo> paths(pathCount);
+    for (PathInfo &path : paths)
+    {
+        uint32_t w = PathExtent(sizes, rng, maxExtent);
+        uint32_t h = PathExtent(sizes, rng, maxExtent);
+
+        float cx, cy;
+        if (strcmp(overlap, "clustered") == 0)
+        {
+            const auto &cluster = clusters[rng() % clusters.size()];
+            cx = cluster.first + spread(rng);
+            cy = cluster.second + spread(rng);
+        }
+        else if (strcmp(overlap, "stacked") == 0)
+        {
+            cx = widthInTiles / 2.0f;
+            cy = heightInTiles / 2.0f;
+        }
+        else
+        {
+            cx = std::uniform_real_distribution<float>(0, widthInTiles)(rng);
+            cy = std::uniform_real_distribution<float>(0, heightInTiles)(rng);
+        }
+
+        uint32_t l = std::clamp<int32_t>(std::lround(cx - w / 2.0f), 0, 0xffff);
+        uint32_t t = std::clamp<int32_t>(std::lround(cy - h / 2.0f), 0, 0xffff);
+        uint32_t r = std::min<uint32_t>(l + w, 0xffff);
+        uint32_t b = std::min<uint32_t>(t + h, 0xffff);
+        path.bb_tl = (t << 16) | l;
+        path.bb_br = (b << 16) | r;
+
+        if (strcmp(sizes, "degenerate") == 0)
+        {
+            uint32_t roll = rng() % 4;
+            if (roll == 0)
+            {
+                path.bb_tl = 0;
+                path.bb_br = (heightInTiles << 16) | widthInTiles;
+            }
+            else if (roll == 1)
+            {
+                path.bb_tl = (t << 16) | r;
+                path.bb_br = (b << 16) | l;
+            }
+            else if (roll == 2)
+            {
+                path.bb_tl = (b << 16) | l;
+                path.bb_br = (t << 16) | r;
+            }
+        }
+    }
+    return paths;
+}
+
+// Corners of every path in pixels, as input for the path encoder.
+static std::vector<PathPoint> SceneGeometry(const std::vector<PathInfo> &paths, std::vector<PathGeometry> &geometry)
+{
+    std::vector<PathPoint> points;
+    points.reserve(paths.size() * 4);
+    geometry.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        float l = (paths[i].bb_tl & 0xffff) * float(kTileSize), t = (paths[i].bb_tl >> 16) * float(kTileSize);
+        float r = (paths[i].bb_br & 0xffff) * float(kTileSize), b = (paths[i].bb_br >> 16) * float(kTileSize);
+        geometry[i] = {static_cast<uint32_t>(points.size()), 4};
+        points.insert(points.end(), {{l, t}, {r, t}, {r, b}, {l, b}});
+    }
+    return points;
+}
+
+// One BinKey() per path, for the bin of its top left corner. Unlike the
+// full bin lists the key count does not depend on the size distribution.
+static std::vector<uint32_t> SceneSortKeys(const std::vector<PathInfo> &paths, const BinningVariant &variant)
+{
+    BinGrid grid = GetBinGrid(kWidth, kHeight, variant.tileSize);
+    std::vector<uint32_t> keys(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        uint32_t x = std::min((paths[i].bb_tl & 0xffff) / variant.tileSize, grid.widthInBins - 1);
+        uint32_t y = std::min((paths[i].bb_tl >> 16) / variant.tileSize, grid.heightInBins - 1);
+        keys[i] = BinKey(y * grid.widthInBins + x, static_cast<uint32_t>(i));
+    }
+    return keys;
+}
+
+// True when `offsets` delimits the bins of sorted `keys`.
+static bool SegmentsMatch(const std::vector<uint32_t> &keys, const std::vector<uint32_t> &offsets)
+{
+    if (offsets.size() != kNumBins + 1 || offsets[kNumBins] != keys.size())
+    {
+        return false;
+    }
+    for (uint32_t bin = 0; bin < kNumBins; bin++)
+    {
+        for (uint32_t i = offsets[bin]; i < offsets[bin + 1]; i++)
+        {
+            if (i >= keys.size() || keys[i] >> kBinKeyShift != bin)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Per-bin path counts summed over the partitions. Culling moves paths to
+// other partitions, so only these match the CPU reference then.
+static std::vector<uint32_t> BinTotals(const std::vector<uint32_t> &binHeader)
+{
+    std::vector<uint32_t> totals(kNumBins);
+    for (size_t i = 0; i < binHeader.size(); i++)
+    {
+        totals[i % kNumBins] += binHeader[i];
+    }
+    return totals;
+}
+
+static std::string PercentilesJson(std::vector<double> samples)
+{
+    if (samples.empty())
+    {
+        return "null";
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double p)
+    { return samples[std::min<size_t>(samples.size() - 1, static_cast<size_t>(p * samples.size()))]; };
+
+    char json[128];
+    snprintf(json, sizeof(json), "{\"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f}", at(0.5), at(0.9), at(0.99));
+    return json;
+}
+
+static double Median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples.empty() ? 0 : samples[samples.size() / 2];
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    options.asyncPipelines = false;
+    std::vector<uint32_t> pathCounts = {1000, 10000, 100000, 1000000};
+    uint32_t iterations = 10;
+    const char *outPath = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *value = nullptr;
+        if (ParseFlag(argv[i], "--backend", &value))
+        {
+            options.backendType = strcmp(value, "null") == 0 ? wgpu::BackendType::Null : wgpu::BackendType::Vulkan;
+            options.forceFallbackAdapter = strcmp(value, "swiftshader") == 0;
+        }
+        else if (ParseFlag(argv[i], "--mode", &value))
+        {
+            options.binningMode = BinningMode::Atomic;
+            if (strcmp(value, "bitmap") == 0)
+            {
+                options.binningMode = BinningMode::Bitmap;
+            }
+            else if (strcmp(value, "subgroup") == 0)
+            {
+                options.binningMode = BinningMode::Subgroup;
+            }
+        }
+        else if (ParseFlag(argv[i], "--paths", &value))
+        {
+            pathCounts.clear();
+            for (const char *p = value; *p != '\0'; p = strchr(p, ',') ? strchr(p, ',') + 1 : p + strlen(p))
+            {
+                pathCounts.push_back(atoi(p));
+            }
+        }
+        else if (ParseFlag(argv[i], "--iterations", &value))
+        {
+            iterations = std::max(atoi(value), 1);
+        }
+        else if (ParseFlag(argv[i], "--out", &value))
+        {
+            outPath = value;
+        }
+        else if (ParseFlag(argv[i], "--workgroup-size", &value))
+        {
+            options.variant.workgroupSize = atoi(value);
+        }
+        else if (ParseFlag(argv[i], "--tile-size", &value))
+        {
+            options.variant.tileSize = atoi(value);
+        }
+        else if (strcmp(argv[i], "--auto-tune") == 0)
+        {
+            options.autoTune = true;
+        }
+        else if (ParseFlag(argv[i], "--encoder-threads", &value))
+        {
+            options.encoderThreads = atoi(value);
+        }
+        else if (strcmp(argv[i], "--no-subgroups") == 0)
+        {
+            options.subgroups = false;
+        }
+        else if (strcmp(argv[i], "--compact") == 0)
+        {
+            options.compactPaths = true;
+        }
+        else if (strcmp(argv[i], "--cull") == 0)
+        {
+            options.cullPaths = true;
+        }
+        else
+        {
+            LOGE("Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    ThreadPool encoderPool(options.encoderThreads);
+
+    Clock::time_point initStart = Clock::now();
+    Init(kWidth, kHeight, options);
+    double initMs = MillisecondsSince(initStart);
+    bool gpu = PipelinesReady();
+    if (gpu && options.autoTune)
+    {
+        // Tune on a mid-sized scene rather than the sample data.
+        std::vector<PathInfo> paths = GenerateScene(100000, "mixed", "uniform", 1);
+        SetPaths(paths.data(), paths.size());
+        AutoTuneBinning();
+    }
+    BinningVariant variant = GetBinningVariant();
+
+    FILE *out = outPath ? fopen(outPath, "w") : stdout;
+    if (out == nullptr)
+    {
+        LOGE("Failed to open %s\n", outPath);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"mode\": \"%s\",\n  \"kernel\": \"%s\",\n  \"workgroup_size\": %u,\n  \"tile_size\": %u,\n  \"compact_paths\": %s,\n  \"cull_paths\": %s,\n  \"encoder_threads\": %u,\n  \"gpu\": %s,\n  \"init_ms\": %.4f,\n  \"cpu_kernel\": \"%s\",\n  \"results\": [",
+            options.binningMode == BinningMode::Bitmap ? "bitmap" : options.binningMode == BinningMode::Subgroup ? "subgroup" : "atomic", GetBinningKernelName(), variant.workgroupSize, variant.tileSize,
+            options.compactPaths && CompactPathsFit(kWidth, kHeight, variant.tileSize) ? "true" : "false", options.cullPaths ? "true" : "false", encoderPool.ThreadCount(), gpu ? "true" : "false", initMs, CpuBinnerKernelName());
+
+    bool first = true;
+    for (uint32_t pathCount : pathCounts)
+    {
+        for (const char *sizes : kSizeDistributions)
+        {
+            for (const char *overlap : kOverlapPatterns)
+            {
+                std::vector<PathInfo> paths = GenerateScene(pathCount, sizes, overlap, pathCount);
+                uint32_t numPartitions = NumPartitions(pathCount, variant.workgroupSize);
+                std::vector<uint32_t> cpuHeader(numPartitions * kNumBins);
+                std::vector<uint32_t> cpuBitmap(numPartitions * kBitmapWords);
+                std::vector<uint32_t> gpuHeader;
+                std::vector<PathGeometry> geometry;
+                std::vector<PathPoint> points = SceneGeometry(paths, geometry);
+                std::vector<PathInfo> serialEncoded(pathCount), parallelEncoded(pathCount);
+
+                bool sortable = gpu && pathCount <= 1u << kBinKeyShift;
+                std::vector<uint32_t> sortKeys = sortable ? SceneSortKeys(paths, variant) : std::vector<uint32_t>();
+                std::vector<uint32_t> expectedKeys = sortKeys;
+                std::sort(expectedKeys.begin(), expectedKeys.end());
+                std::vector<uint32_t> sortedKeys, segmentOffsets;
+
+                std::vector<double> uploadMs, dispatchMs, readbackMs, cpuMs, encodeMs, encodeSerialMs, sortMs;
+                bool match = true;
+                bool encodeMatch = true;
+                bool sortMatch = true;
+                for (uint32_t i = 0; i < iterations; i++)
+                {
+                    Clock::time_point start = Clock::now();
+                    EncodePathRange(points.data(), geometry.data(), 0, pathCount, kWidth, kHeight, kTileSize, serialEncoded.data());
+                    encodeSerialMs.push_back(MillisecondsSince(start));
+
+                    start = Clock::now();
+                    EncodePaths(encoderPool, points.data(), geometry.data(), pathCount, kWidth, kHeight, kTileSize, parallelEncoded.data());
+                    encodeMs.push_back(MillisecondsSince(start));
+                    encodeMatch = encodeMatch && memcmp(serialEncoded.data(), parallelEncoded.data(), pathCount * sizeof(PathInfo)) == 0;
+
+                    start = Clock::now();
+                    CpuBin(paths.data(), pathCount, kWidth, kHeight, cpuHeader.data(), cpuBitmap.data(), variant);
+                    cpuMs.push_back(MillisecondsSince(start));
+
+                    if (!gpu)
+                    {
+                        continue;
+                    }
+
+                    start = Clock::now();
+                    SetPaths(paths.data(), pathCount);
+                    WaitForIdle();
+                    uploadMs.push_back(MillisecondsSince(start));
+
+                    start = Clock::now();
+                    DispatchBinning();
+                    WaitForIdle();
+                    dispatchMs.push_back(MillisecondsSince(start));
+
+                    start = Clock::now();
+                    bool ok = ReadBackBinHeader(gpuHeader);
+                    readbackMs.push_back(MillisecondsSince(start));
+                    bool binsMatch = options.cullPaths ? gpuHeader.size() == cpuHeader.size() && BinTotals(gpuHeader) == BinTotals(cpuHeader) : gpuHeader == cpuHeader;
+                    match = match && ok && binsMatch;
+
+                    if (!sortable)
+                    {
+                        continue;
+                    }
+                    UploadSortKeys(sortKeys.data(), pathCount);
+                    WaitForIdle();
+
+                    start = Clock::now();
+                    DispatchSort();
+                    WaitForIdle();
+                    sortMs.push_back(MillisecondsSince(start));
+
+                    ok = ReadBackSortedKeys(sortedKeys, segmentOffsets);
+                    sortMatch = sortMatch && ok && sortedKeys == expectedKeys && SegmentsMatch(sortedKeys, segmentOffsets);
+                }
+
+                double cpuMedian = Median(cpuMs);
+                double gpuMedian = Median(dispatchMs);
+                fprintf(out, "%s\n    {\"paths\": %u, \"sizes\": \"%s\", \"overlap\": \"%s\",\n", first ? "" : ",", pathCount, sizes, overlap);
+                fprintf(out, "     \"cpu\": {\"bin_ms\": %s, \"paths_per_second\": %.0f, \"encode_ms\": %s, \"encode_serial_ms\": %s, \"encode_match\": %s},\n",
+                        PercentilesJson(cpuMs).c_str(), cpuMedian > 0 ? pathCount / (cpuMedian / 1000) : 0,
+                        PercentilesJson(encodeMs).c_str(), PercentilesJson(encodeSerialMs).c_str(), encodeMatch ? "true" : "false");
+                if (gpu)
+                {
+                    fprintf(out, "     \"gpu\": {\"upload_ms\": %s, \"dispatch_ms\": %s, \"readback_ms\": %s, \"paths_per_second\": %.0f},\n",
+                            PercentilesJson(uploadMs).c_str(), PercentilesJson(dispatchMs).c_str(), PercentilesJson(readbackMs).c_str(),
+                            gpuMedian > 0 ? pathCount / (gpuMedian / 1000) : 0);
+                    if (sortable)
+                    {
+                        double sortMedian = Median(sortMs);
+                        fprintf(out, "     \"sort\": {\"sort_ms\": %s, \"keys_per_second\": %.0f, \"match\": %s},\n",
+                                PercentilesJson(sortMs).c_str(), sortMedian > 0 ? pathCount / (sortMedian / 1000) : 0, sortMatch ? "true" : "false");
+                    }
+                    fprintf(out, "     \"match\": %s}", match ? "true" : "false");
+                }
+                else
+                {
+                    fprintf(out, "     \"gpu\": null}");
+                }
+                first = false;
+            }
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+#ifndef __DAWN_ANDROID_BINNING_H
+#define __DAWN_ANDROID_BINNING_H
+
+#include <cstdint>
+#include <algorithm>
+
+// Host side mirror of the types and constants used by the binning shader in
+// lib.cpp. Keep the two in sync.
+namespace DawnAndroid
+{
+    // Defaults of the WG_SIZE, N_TILE and TILE_SIZE overrides in the shader.
+    // kWorkgroupSize is also the largest supported workgroup size.
+    constexpr uint32_t kWorkgroupSize = 256;
+    constexpr uint32_t kNumBins = 256;
+    constexpr uint32_t kTileSize = 16;
+
+    // Number of u32 words in the per-partition bin occupancy bitmap.
+    constexpr uint32_t kBitmapWords = kNumBins / 32;
+
+    // Path bounding box in tile coordinates, packed as (t << 16 | l) and (b << 16 | r).
+    struct PathInfo
+    {
+        uint32_t bb_tl;
+        uint32_t bb_br;
+    };
+
+    // Moves path `index` from `oldInfo` to `newInfo`; PathEdit in the
+    // incremental binning shader.
+    struct PathEdit
+    {
+        uint32_t index;
+        PathInfo oldInfo;
+        PathInfo newInfo;
+    };
+
+    // Edits [begin, end) of a batch sorted by path index all fall into `partition`.
+    struct PartitionEdits
+    {
+        uint32_t partition;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t _padding;
+    };
+
+    // Entries the tiling stages asked for in the bin and tile path lists;
+    // TilingCounters in the tiling shader.
+    struct TilingCounters
+    {
+        uint32_t binPaths;
+        uint32_t tilePaths;
+    };
+
+    // Sorted bin lists sort one (bin << kBinKeyShift | path) key per
+    // covered bin and path, so they hold at most 2^kBinKeyShift paths.
+    constexpr uint32_t kBinKeyShift = 20;
+    constexpr uint32_t kBinKeyBits = kBinKeyShift + 8;
+    static_assert(kNumBins <= 1u << (kBinKeyBits - kBinKeyShift));
+
+    inline uint32_t BinKey(uint32_t bin, uint32_t path)
+    {
+        return bin << kBinKeyShift | path;
+    }
+
+    // Arguments of DispatchWorkgroupsIndirect, written by GPU passes.
+    struct DispatchArgs
+    {
+        uint32_t x;
+        uint32_t y;
+        uint32_t z;
+    };
+
+    struct ComputeUniforms
+    {
+        uint32_t path_count;
+        uint32_t width;
+        uint32_t height;
+        uint32_t _padding;
+    };
+
+    inline uint32_t DivUp(uint32_t v, uint32_t c)
+    {
+        return (v + (c - 1)) / c;
+    }
+
+    // Specialization of the binning kernels through pipeline overrides.
+    // Smaller workgroups trade occupancy for shorter per-partition loops;
+    // the tile size changes what a bin covers, so it is a resolution choice
+    // rather than a tuning knob.
+    struct BinningVariant
+    {
+        // Multiple of 32, at most kWorkgroupSize.
+        uint32_t workgroupSize = kWorkgroupSize;
+        // Power of two.
+        uint32_t tileSize = kTileSize;
+
+        bool operator==(const BinningVariant &other) const
+        {
+            return workgroupSize == other.workgroupSize && tileSize == other.tileSize;
+        }
+    };
+
+    // Each workgroup bins workgroupSize paths (a "partition") and writes
+    // kNumBins counts to bin_header[partition * kNumBins + bin] plus
+    // kBitmapWords occupancy words to bin_bitmap[partition * kBitmapWords + word].
+    inline uint32_t NumPartitions(uint32_t pathCount, uint32_t workgroupSize = kWorkgroupSize)
+    {
+        return std::max(DivUp(pathCount, workgroupSize), 1u);
+    }
+
+    struct BinGrid
+    {
+        uint32_t widthInBins;
+        uint32_t heightInBins;
+    };
+
+    // Same as bin_grid() in the shader; the grid is clamped so it fits in kNumBins.
+    inline BinGrid GetBinGrid(uint32_t width, uint32_t height, uint32_t tileSize = kTileSize)
+    {
+        uint32_t w = std::clamp(DivUp(DivUp(width, tileSize), tileSize), 1u, kNumBins);
+        uint32_t h = std::min(DivUp(DivUp(height, tileSize), tileSize), kNumBins / w);
+        return {w, h};
+    }
+
+    // Compact path format: one u32 per path with l, t, r and b as 8-bit tile
+    // coordinates (l in the low byte). Coordinates are clamped to the extent
+    // of the bin grid in tiles, which leaves the covered bins and tiles
+    // unchanged, so it only needs that extent to fit in a byte.
+    inline bool CompactPathsFit(uint32_t width, uint32_t height, uint32_t tileSize = kTileSize)
+    {
+        BinGrid grid = GetBinGrid(width, height, tileSize);
+        return std::max(grid.widthInBins, grid.heightInBins) * tileSize <= 0xff;
+    }
+
+    // Same as encode_compact_path() in the shader.
+    inline uint32_t EncodeCompactPath(const PathInfo &path, uint32_t extentX, uint32_t extentY)
+    {
+        uint32_t l = std::min(path.bb_tl & 0xffff, extentX);
+        uint32_t t = std::min(path.bb_tl >> 16, extentY);
+        uint32_t r = std::min(path.bb_br & 0xffff, extentX);
+        uint32_t b = std::min(path.bb_br >> 16, extentY);
+        return l | (t << 8) | (r << 16) | (b << 24);
+    }
+
+    inline PathInfo DecodeCompactPath(uint32_t word)
+    {
+        uint32_t l = word & 0xff;
+        uint32_t t = (word >> 8) & 0xff;
+        uint32_t r = (word >> 16) & 0xff;
+        uint32_t b = word >> 24;
+        return {(t << 16) | l, (b << 16) | r};
+    }
+}
+
+#endif // define __DAWN_ANDROID_BINNING_H
@@ -0,0 +1,228 @@
+#include "cpu_binner.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_BINNER_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CPU_BINNER_NEON 1
+#endif
+
+namespace DawnAndroid
+{
+    // Bin rects of a single partition in structure-of-arrays form.
+    struct PartitionRects
+    {
+        uint32_t x0[kWorkgroupSize];
+        uint32_t y0[kWorkgroupSize];
+        uint32_t x1[kWorkgroupSize];
+        uint32_t y1[kWorkgroupSize];
+    };
+
+    // Tile sizes are powers of two, so the vector kernels divide by shifting.
+    typedef void (*DecodeRectsFn)(const PathInfo *paths, uint32_t count, BinGrid grid, uint32_t tileShift, PartitionRects *rects);
+
+    // Same math as get_trbl_rect() and the tile range computation in the shader.
+    static void DecodeRectsScalar(const PathInfo *paths, uint32_t count, BinGrid grid, uint32_t tileShift, PartitionRects *rects)
+    {
+        uint32_t tileSize = 1u << tileShift;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t t = (paths[i].bb_tl >> 16) & 0xffff;
+            uint32_t l = paths[i].bb_tl & 0xffff;
+            uint32_t b = (paths[i].bb_br >> 16) & 0xffff;
+            uint32_t r = paths[i].bb_br & 0xffff;
+
+            rects->x0[i] = std::min(l / tileSize, grid.widthInBins);
+            rects->y0[i] = std::min(t / tileSize, grid.heightInBins);
+            rects->x1[i] = std::min(DivUp(r, tileSize), grid.widthInBins);
+            rects->y1[i] = std::min(DivUp(b, tileSize), grid.heightInBins);
+        }
+    }
+
+#if CPU_BINNER_X86
+    __attribute__((target("avx2"))) static void DecodeRectsAvx2(const PathInfo *paths, uint32_t count, BinGrid grid, uint32_t tileShift, PartitionRects *rects)
+    {
+        const __m128i shift = _mm_cvtsi32_si128(tileShift);
+        const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        const __m256i mask = _mm256_set1_epi32(0xffff);
+        const __m256i roundUp = _mm256_set1_epi32((1u << tileShift) - 1);
+        const __m256i gridW = _mm256_set1_epi32(grid.widthInBins);
+        const __m256i gridH = _mm256_set1_epi32(grid.heightInBins);
+
+        uint32_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            // [tl0 br0 .. tl3 br3] [tl4 br4 .. tl7 br7] -> [tl0..tl7] [br0..br7]
+            __m256i lo = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)&paths[i]), deinterleave);
+            __m256i hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)&paths[i + 4]), deinterleave);
+            __m256i tl = _mm256_permute2x128_si256(lo, hi, 0x20);
+            __m256i br = _mm256_permute2x128_si256(lo, hi, 0x31);
+
+            __m256i t = _mm256_srli_epi32(tl, 16);
+            __m256i l = _mm256_and_si256(tl, mask);
+            __m256i b = _mm256_srli_epi32(br, 16);
+            __m256i r = _mm256_and_si256(br, mask);
+
+            __m256i x0 = _mm256_min_epu32(_mm256_srl_epi32(l, shift), gridW);
+            __m256i y0 = _mm256_min_epu32(_mm256_srl_epi32(t, shift), gridH);
+            __m256i x1 = _mm256_min_epu32(_mm256_srl_epi32(_mm256_add_epi32(r, roundUp), shift), gridW);
+            __m256i y1 = _mm256_min_epu32(_mm256_srl_epi32(_mm256_add_epi32(b, roundUp), shift), gridH);
+
+            _mm256_storeu_si256((__m256i *)&rects->x0[i], x0);
+            _mm256_storeu_si256((__m256i *)&rects->y0[i], y0);
+            _mm256_storeu_si256((__m256i *)&rects->x1[i], x1);
+            _mm256_storeu_si256((__m256i *)&rects->y1[i], y1);
+        }
+
+        PartitionRects tail;
+        DecodeRectsScalar(paths + i, count - i, grid, tileShift, &tail);
+        for (uint32_t j = i; j < count; j++)
+        {
+            rects->x0[j] = tail.x0[j - i];
+            rects->y0[j] = tail.y0[j - i];
+            rects->x1[j] = tail.x1[j - i];
+            rects->y1[j] = tail.y1[j - i];
+        }
+    }
+#endif
+
+#if CPU_BINNER_NEON
+    static void DecodeRectsNeon(const PathInfo *paths, uint32_t count, BinGrid grid, uint32_t tileShift, PartitionRects *rects)
+    {
+        // vshlq with a negative count shifts right.
+        const int32x4_t shift = vdupq_n_s32(-static_cast<int32_t>(tileShift));
+        const uint32x4_t mask = vdupq_n_u32(0xffff);
+        const uint32x4_t roundUp = vdupq_n_u32((1u << tileShift) - 1);
+        const uint32x4_t gridW = vdupq_n_u32(grid.widthInBins);
+        const uint32x4_t gridH = vdupq_n_u32(grid.heightInBins);
+
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            // vld2 deinterleaves into val[0] = tl, val[1] = br.
+            uint32x4x2_t words = vld2q_u32(&paths[i].bb_tl);
+
+            uint32x4_t t = vshrq_n_u32(words.val[0], 16);
+            uint32x4_t l = vandq_u32(words.val[0], mask);
+            uint32x4_t b = vshrq_n_u32(words.val[1], 16);
+            uint32x4_t r = vandq_u32(words.val[1], mask);
+
+            vst1q_u32(&rects->x0[i], vminq_u32(vshlq_u32(l, shift), gridW));
+            vst1q_u32(&rects->y0[i], vminq_u32(vshlq_u32(t, shift), gridH));
+            vst1q_u32(&rects->x1[i], vminq_u32(vshlq_u32(vaddq_u32(r, roundUp), shift), gridW));
+            vst1q_u32(&rects->y1[i], vminq_u32(vshlq_u32(vaddq_u32(b, roundUp), shift), gridH));
+        }
+
+        PartitionRects tail;
+        DecodeRectsScalar(paths + i, count - i, grid, tileShift, &tail);
+        for (uint32_t j = i; j < count; j++)
+        {
+            rects->x0[j] = tail.x0[j - i];
+            rects->y0[j] = tail.y0[j - i];
+            rects->x1[j] = tail.x1[j - i];
+            rects->y1[j] = tail.y1[j - i];
+        }
+    }
+#endif
+
+    static DecodeRectsFn SelectDecodeRects(const char **name)
+    {
+#if CPU_BINNER_X86
+        if (__builtin_cpu_supports("avx2"))
+        {
+            *name = "avx2";
+            return DecodeRectsAvx2;
+        }
+#elif CPU_BINNER_NEON
+        *name = "neon";
+        return DecodeRectsNeon;
+#endif
+        *name = "scalar";
+        return DecodeRectsScalar;
+    }
+
+    static const char *decodeRectsName = nullptr;
+    static DecodeRectsFn decodeRects = SelectDecodeRects(&decodeRectsName);
+
+    const char *CpuBinnerKernelName()
+    {
+        return decodeRectsName;
+    }
+
+    void ForceScalarCpuBinner(bool force)
+    {
+        if (force)
+        {
+            decodeRectsName = "scalar";
+            decodeRects = DecodeRectsScalar;
+        }
+        else
+        {
+            decodeRects = SelectDecodeRects(&decodeRectsName);
+        }
+    }
+
+    void CpuBin(const PathInfo *paths, uint32_t count, uint32_t width, uint32_t height,
+                uint32_t *binHeader, uint32_t *binBitmap, const BinningVariant &variant)
+    {
+        BinGrid grid = GetBinGrid(width, height, variant.tileSize);
+        uint32_t numPartitions = NumPartitions(count, variant.workgroupSize);
+        uint32_t tileShift = __builtin_ctz(variant.tileSize);
+        uint32_t stride = grid.widthInBins + 1;
+
+        PartitionRects rects;
+        // 2D difference grid: every path touches four corners instead of every
+        // bin it covers, and a prefix sum turns it back into per-bin counts.
+        // It has (w + 1) * (h + 1) cells with w * h <= kNumBins.
+        int32_t diff[(kNumBins + 1) * 2];
+
+        for (uint32_t partition = 0; partition < numPartitions; partition++)
+        {
+            uint32_t first = partition * variant.workgroupSize;
+            uint32_t n = first < count ? std::min(count - first, variant.workgroupSize) : 0;
+            decodeRects(paths + first, n, grid, tileShift, &rects);
+
+            uint32_t diffSize = stride * (grid.heightInBins + 1);
+            memset(diff, 0, diffSize * sizeof(int32_t));
+            for (uint32_t i = 0; i < n; i++)
+            {
+                uint32_t x0 = rects.x0[i], y0 = rects.y0[i], x1 = rects.x1[i], y1 = rects.y1[i];
+                if (x0 >= x1 || y0 >= y1)
+                {
+                    continue;
+                }
+                diff[y0 * stride + x0] += 1;
+                diff[y0 * stride + x1] -= 1;
+                diff[y1 * stride + x0] -= 1;
+                diff[y1 * stride + x1] += 1;
+            }
+
+            uint32_t *counts = binHeader + partition * kNumBins;
+            uint32_t *bitmap = binBitmap + partition * kBitmapWords;
+            memset(counts, 0, kNumBins * sizeof(uint32_t));
+            memset(bitmap, 0, kBitmapWords * sizeof(uint32_t));
+
+            for (uint32_t y = 0; y < grid.heightInBins; y++)
+            {
+                int32_t row = 0;
+                for (uint32_t x = 0; x < grid.widthInBins; x++)
+                {
+                    row += diff[y * stride + x];
+                    // Accumulate down the columns in place.
+                    int32_t above = y > 0 ? diff[(y - 1) * stride + x] : 0;
+                    diff[y * stride + x] = row + above;
+
+                    uint32_t bin = y * grid.widthInBins + x;
+                    counts[bin] = static_cast<uint32_t>(diff[y * stride + x]);
+                    if (counts[bin] != 0)
+                    {
+                        bitmap[bin / 32] |= 1u << (bin % 32);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef __DAWN_ANDROID_CPU_BINNER_H
+#define __DAWN_ANDROID_CPU_BINNER_H
+
+#include "binning.h"
+
+#include <cstdint>
+
+namespace DawnAndroid
+{
+    // Host implementation of the binning shader specialized for `variant`.
+    // Produces bit-exact copies of bin_header and bin_bitmap, sized
+    // NumPartitions(count, variant.workgroupSize) * kNumBins and
+    // * kBitmapWords words. Used to validate the GPU output and as a fallback
+    // when no adapter is available.
+    void CpuBin(const PathInfo *paths, uint32_t count, uint32_t width, uint32_t height,
+                uint32_t *binHeader, uint32_t *binBitmap, const BinningVariant &variant = {});
+
+    // Name of the rect decode kernel selected at runtime ("avx2", "neon" or "scalar").
+    const char *CpuBinnerKernelName();
+    // Switches to the scalar rect decode, or with false back to the runtime
+    // choice, so that the vector kernels can be checked against it.
+    void ForceScalarCpuBinner(bool force);
+}
+
+#endif // define __DAWN_ANDROID_CPU_BINNER_H
@@ -0,0 +1,162 @@
+// Checks CpuBin() against a naive loop over every bin and path, with the
+// runtime selected rect decode and with the scalar one. The scenes mix
+// ordinary boxes with empty, inverted and off-grid ones, over workgroup
+// sizes, tile sizes and surfaces whose bin grid gets clamped. Needs no GPU.
+//
+//   cpu_binner_check [--seed=N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "cpu_binner.h"
+
+using namespace DawnAndroid;
+
+// Per bin, which paths of the partition cover it, straight from the bin
+// grid definition rather than CpuBin()'s difference grid.
+static void NaiveBin(const std::vector<PathInfo> &paths, uint32_t width, uint32_t height, const BinningVariant &variant,
+                     std::vector<uint32_t> &binHeader, std::vector<uint32_t> &binBitmap)
+{
+    BinGrid grid = GetBinGrid(width, height, variant.tileSize);
+    uint32_t count = static_cast<uint32_t>(paths.size());
+    uint32_t numPartitions = NumPartitions(count, variant.workgroupSize);
+    binHeader.assign(numPartitions * kNumBins, 0);
+    binBitmap.assign(numPartitions * kBitmapWords, 0);
+
+    for (uint32_t partition = 0; partition < numPartitions; partition++)
+    {
+        for (uint32_t y = 0; y < grid.heightInBins; y++)
+        {
+            for (uint32_t x = 0; x < grid.widthInBins; x++)
+            {
+                uint32_t bin = y * grid.widthInBins + x;
+                uint32_t total = 0;
+                for (uint32_t i = partition * variant.workgroupSize; i < std::min(count, (partition + 1) * variant.workgroupSize); i++)
+                {
+                    uint32_t l = paths[i].bb_tl & 0xffff;
+                    uint32_t t = paths[i].bb_tl >> 16;
+                    uint32_t r = paths[i].bb_br & 0xffff;
+                    uint32_t b = paths[i].bb_br >> 16;
+                    bool inX = x >= std::min(l / variant.tileSize, grid.widthInBins) && x < std::min(DivUp(r, variant.tileSize), grid.widthInBins);
+                    bool inY = y >= std::min(t / variant.tileSize, grid.heightInBins) && y < std::min(DivUp(b, variant.tileSize), grid.heightInBins);
+                    total += inX && inY;
+                }
+                binHeader[partition * kNumBins + bin] = total;
+                if (total != 0)
+                {
+                    binBitmap[partition * kBitmapWords + bin / 32] |= 1u << (bin % 32);
+                }
+            }
+        }
+    }
+}
+
+static PathInfo MakePath(uint32_t l, uint32_t t, uint32_t r, uint32_t b)
+{
+    return {(t << 16) | l, (b << 16) | r};
+}
+
+// Mostly ordinary boxes within the surface, plus the cases the binner has
+// to treat as empty or clamp.
+static std::vector<PathInfo> GenerateScene(uint32_t count, uint32_t widthInTiles, uint32_t heightInTiles, std::mt19937 &rng)
+{
+    auto range = [&rng](uint32_t lo, uint32_t hi)
+    { return std::uniform_int_distribution<uint32_t>(lo, hi)(rng); };
+
+    std::vector<PathInfo> paths(count);
+    for (PathInfo &path : paths)
+    {
+        uint32_t l = range(0, widthInTiles);
+        uint32_t t = range(0, heightInTiles);
+        switch (range(0, 7))
+        {
+        case 0:
+            // Empty: zero width or height.
+            path = range(0, 1) ? MakePath(l, t, l, t + range(0, 8)) : MakePath(l, t, l + range(0, 8), t);
+            break;
+        case 1:
+            // Inverted: l > r or t > b.
+            path = range(0, 1) ? MakePath(l + range(1, 64), t, l, t + range(1, 64)) : MakePath(l, t + range(1, 64), l + range(1, 64), t);
+            break;
+        case 2:
+            // Reaches past the bin grid, up to the largest coordinate.
+            path = MakePath(l, t, range(l, 0xffff), range(t, 0xffff));
+            break;
+        case 3:
+            path = MakePath(0, 0, widthInTiles, heightInTiles);
+            break;
+        default:
+            path = MakePath(l, t, l + range(1, 64), t + range(1, 64));
+            break;
+        }
+    }
+    return paths;
+}
+
+int main(int argc, const char *argv[])
+{
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--seed=", 7) == 0)
+        {
+            seed = static_cast<uint32_t>(strtoul(argv[i] + 7, nullptr, 10));
+        }
+        else
+        {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // The last surface has more bins across than kNumBins, so its grid is clamped.
+    const uint32_t surfaces[][2] = {{1080, 2400}, {100, 100}, {1, 1}, {65535, 300}};
+    const uint32_t workgroupSizes[] = {32, 64, 256};
+    const uint32_t tileSizes[] = {4, 16, 32};
+    // Counts around the vector widths and partition boundaries.
+    const uint32_t counts[] = {0, 1, 3, 7, 9, 255, 257, 1000};
+
+    std::mt19937 rng(seed);
+    ForceScalarCpuBinner(false);
+    const char *kernels[] = {CpuBinnerKernelName(), "scalar"};
+    uint32_t cases = 0;
+    uint32_t failures = 0;
+    std::vector<uint32_t> expectedHeader, expectedBitmap;
+    for (const uint32_t *surface : surfaces)
+    {
+        for (uint32_t tileSize : tileSizes)
+        {
+            for (uint32_t workgroupSize : workgroupSizes)
+            {
+                for (uint32_t count : counts)
+                {
+                    BinningVariant variant = {workgroupSize, tileSize};
+                    std::vector<PathInfo> paths = GenerateScene(count, DivUp(surface[0], tileSize), DivUp(surface[1], tileSize), rng);
+                    NaiveBin(paths, surface[0], surface[1], variant, expectedHeader, expectedBitmap);
+
+                    for (uint32_t k = 0; k < 2; k++)
+                    {
+                        ForceScalarCpuBinner(k == 1);
+                        std::vector<uint32_t> binHeader(expectedHeader.size(), 0xdeadbeef);
+                        std::vector<uint32_t> binBitmap(expectedBitmap.size(), 0xdeadbeef);
+                        CpuBin(paths.data(), count, surface[0], surface[1], binHeader.data(), binBitmap.data(), variant);
+                        cases++;
+                        if (binHeader != expectedHeader || binBitmap != expectedBitmap)
+                        {
+                            failures++;
+                            fprintf(stderr, "Mismatch with the %s kernel: %ux%u, tile size %u, workgroup size %u, %u paths\n",
+                                    kernels[k], surface[0], surface[1], tileSize, workgroupSize, count);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    ForceScalarCpuBinner(false);
+
+    printf("%u of %u cases match (kernels %s and %s, seed %u)\n", cases - failures, cases, kernels[0], kernels[1], seed);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <bit>
+
+#include "frame_arena.h"
+
+namespace DawnAndroid
+{
+    // Offset of the first `alignment` aligned address at or after `offset` in `chunk`.
+    static size_t AlignedOffset(const uint8_t *chunk, size_t offset, size_t alignment)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t>(chunk) + offset;
+        return offset + (alignment - address % alignment) % alignment;
+    }
+
+    void *FrameArena::Allocate(size_t byteSize, size_t alignment)
+    {
+        size_t offset = mChunks.empty() ? 0 : AlignedOffset(mChunks.back().data.get(), mOffset, alignment);
+        if (mChunks.empty() || offset + byteSize > mChunks.back().size)
+        {
+            AddChunk(byteSize + alignment);
+            offset = AlignedOffset(mChunks.back().data.get(), 0, alignment);
+        }
+
+        mOffset = offset + byteSize;
+        mPeakBytes = std::max(mPeakBytes, mFullBytes + mOffset);
+        return mChunks.back().data.get() + offset;
+    }
+
+    void FrameArena::AddChunk(size_t minSize)
+    {
+        if (!mChunks.empty())
+        {
+            mFullBytes += mOffset;
+        }
+        // Double like a vector would, so a growing frame spills O(log n) times.
+        size_t size = std::max({minSize, kMinChunkSize, mChunks.empty() ? 0 : mChunks.back().size * 2});
+        mChunks.push_back({std::make_unique<uint8_t[]>(size), size});
+        mChunkAllocations++;
+        mOffset = 0;
+    }
+
+    void FrameArena::Reset()
+    {
+        mResets++;
+        if (mChunks.size() > 1)
+        {
+            // One chunk that fits the whole peak frame replaces the spills.
+            // Rounded up, since alignment padding may fall differently.
+            mChunks.clear();
+            AddChunk(std::bit_ceil(mPeakBytes));
+        }
+        mFullBytes = 0;
+        mOffset = 0;
+    }
+
+    FrameArenaStats FrameArena::GetStats() const
+    {
+        FrameArenaStats stats = {};
+        stats.usedBytes = mFullBytes + mOffset;
+        stats.peakBytes = mPeakBytes;
+        for (const Chunk &chunk : mChunks)
+        {
+            stats.capacityBytes += chunk.size;
+        }
+        stats.chunkAllocations = mChunkAllocations;
+        stats.resets = mResets;
+        return stats;
+    }
+}
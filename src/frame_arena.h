@@ -0,0 +1,117 @@
+#ifndef __DAWN_ANDROID_FRAME_ARENA_H
+#define __DAWN_ANDROID_FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace DawnAndroid
+{
+    struct FrameArenaStats
+    {
+        // Bytes handed out since the last Reset() and the most ever in one frame.
+        size_t usedBytes;
+        size_t peakBytes;
+        // Bytes of backing memory currently held.
+        size_t capacityBytes;
+        // Backing chunks malloc'd over the arena's lifetime; flat once the
+        // arena has seen its peak frame.
+        uint64_t chunkAllocations;
+        uint64_t resets;
+    };
+
+    // Bump allocator for host data that lives for one frame. Allocations are
+    // never freed individually; Reset() drops them all at once. When a frame
+    // spilled into extra chunks, Reset() replaces them with a single chunk
+    // of the peak size, so steady state frames do not touch the heap.
+    //
+    // Never pass arena memory as userdata of an asynchronous callback, such
+    // as MapAsync: a callback that resolves after the next Reset() writes
+    // into whatever that frame allocated there.
+    class FrameArena
+    {
+    public:
+        static constexpr size_t kMinChunkSize = 64 * 1024;
+
+        FrameArena() = default;
+        FrameArena(const FrameArena &) = delete;
+        FrameArena &operator=(const FrameArena &) = delete;
+
+        void *Allocate(size_t byteSize, size_t alignment = alignof(std::max_align_t));
+
+        template <typename T>
+        T *Allocate(size_t count)
+        {
+            return static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+        }
+
+        // Invalidates everything allocated since the previous Reset().
+        void Reset();
+
+        FrameArenaStats GetStats() const;
+
+    private:
+        struct Chunk
+        {
+            std::unique_ptr<uint8_t[]> data;
+            size_t size;
+        };
+
+        void AddChunk(size_t minSize);
+
+        std::vector<Chunk> mChunks;
+        // Bump position in mChunks.back().
+        size_t mOffset = 0;
+        // Bytes in the chunks before mChunks.back().
+        size_t mFullBytes = 0;
+        size_t mPeakBytes = 0;
+        uint64_t mChunkAllocations = 0;
+        uint64_t mResets = 0;
+    };
+
+    // Standard allocator over a FrameArena, for containers that live within
+    // a frame. Without an arena it falls back to the heap, so the same code
+    // serves callers that have none.
+    template <typename T>
+    class FrameAllocator
+    {
+    public:
+        using value_type = T;
+
+        FrameAllocator(FrameArena *arena = nullptr) : mArena(arena) {}
+        template <typename U>
+        FrameAllocator(const FrameAllocator<U> &other) : mArena(other.Arena()) {}
+
+        T *allocate(size_t count)
+        {
+            if (mArena)
+            {
+                return mArena->Allocate<T>(count);
+            }
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+        }
+
+        void deallocate(T *data, size_t)
+        {
+            if (!mArena)
+            {
+                ::operator delete(data);
+            }
+        }
+
+        FrameArena *Arena() const { return mArena; }
+
+        template <typename U>
+        bool operator==(const FrameAllocator<U> &other) const { return mArena == other.Arena(); }
+
+    private:
+        FrameArena *mArena;
+    };
+
+    template <typename T>
+    using FrameVector = std::vector<T, FrameAllocator<T>>;
+}
+
+#endif // define __DAWN_ANDROID_FRAME_ARENA_H
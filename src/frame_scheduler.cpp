@@ -0,0 +1,96 @@
+#include <algorithm>
+
+#include "frame_scheduler.h"
+
+namespace DawnAndroid
+{
+    FrameScheduler::FrameScheduler(SchedulerPlatform *platform, int64_t frameIntervalNs)
+        : mPlatform(platform), mFrameIntervalNs(frameIntervalNs)
+    {
+    }
+
+    void FrameScheduler::SetActive(bool active)
+    {
+        if (active && !mActive)
+        {
+            mNextFrameNs = mPlatform->NowNs();
+        }
+        mActive = active;
+    }
+
+    void FrameScheduler::Run()
+    {
+        mStopped = false;
+        while (RunOnce())
+        {
+        }
+    }
+
+    bool FrameScheduler::RunOnce()
+    {
+        if (mStopped)
+        {
+            return false;
+        }
+        if (FramesInFlight() > 0)
+        {
+            PollFrames();
+        }
+        // Frame callbacks run from PollFrames() and may stop the scheduler.
+        if (mStopped)
+        {
+            return false;
+        }
+
+        int64_t now = mPlatform->NowNs();
+        if (mActive && now >= mNextFrameNs)
+        {
+            // Drop the frame rather than block in SubmitFrame() when the GPU is behind.
+            if (FramesInFlight() < kMaxFramesInFlight)
+            {
+                SubmitFrame(mCallback);
+                mStats.frames++;
+            }
+            else
+            {
+                mStats.droppedFrames++;
+            }
+            // Stay on the interval grid; deadlines missed while busy are skipped, not replayed.
+            mNextFrameNs += ((now - mNextFrameNs) / mFrameIntervalNs + 1) * mFrameIntervalNs;
+        }
+        // SubmitFrame() ticks the device too, which can deliver frames.
+        if (mStopped)
+        {
+            return false;
+        }
+
+        // Finished frames wait for the next deadline rather than waking the
+        // thread on their own; a frame of latency is within the frames in
+        // flight anyway.
+        int64_t timeout = SchedulerPlatform::kWaitForever;
+        if (mActive)
+        {
+            timeout = std::max<int64_t>(mNextFrameNs - mPlatform->NowNs(), 0);
+        }
+        else if (FramesInFlight() > 0)
+        {
+            timeout = std::max<int64_t>(mFrameIntervalNs / kGpuPollsPerInterval, 1);
+        }
+        if (timeout == SchedulerPlatform::kWaitForever)
+        {
+            mStats.idleWaits++;
+        }
+        mStats.wakeups++;
+        return mPlatform->Wait(timeout);
+    }
+
+    bool FakeSchedulerPlatform::Wait(int64_t timeoutNs)
+    {
+        if (timeoutNs == kWaitForever)
+        {
+            return false;
+        }
+        mNowNs += timeoutNs;
+        return true;
+    }
+}
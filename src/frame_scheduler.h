@@ -0,0 +1,89 @@
+#ifndef __DAWN_ANDROID_FRAME_SCHEDULER_H
+#define __DAWN_ANDROID_FRAME_SCHEDULER_H
+
+#include <cstdint>
+
+#include "lib.h"
+
+namespace DawnAndroid
+{
+    // Clock and event wait of the thread the scheduler runs on.
+    class SchedulerPlatform
+    {
+    public:
+        // Wait() timeout that only returns once an event arrives.
+        static constexpr int64_t kWaitForever = -1;
+
+        virtual ~SchedulerPlatform() = default;
+        // Monotonic time in nanoseconds.
+        virtual int64_t NowNs() = 0;
+        // Blocks until platform events arrive or `timeoutNs` has passed, and
+        // dispatches them. False once the platform wants the loop to exit.
+        virtual bool Wait(int64_t timeoutNs) = 0;
+    };
+
+    struct SchedulerStats
+    {
+        uint64_t frames;
+        // Frame deadlines that passed with every frame slot still on the GPU.
+        uint64_t droppedFrames;
+        uint64_t wakeups;
+        // Waits without a timeout, i.e. with nothing left to do.
+        uint64_t idleWaits;
+    };
+
+    // Submits a frame per display interval while active and otherwise sleeps
+    // in SchedulerPlatform::Wait(). It never spins: while active it only
+    // wakes at frame deadlines and delivers finished frames there, and when
+    // inactive it waits indefinitely. Frames still on the GPU after it turned
+    // inactive are polled kGpuPollsPerInterval times per frame interval,
+    // since Dawn has no completion handle to wait on.
+    class FrameScheduler
+    {
+    public:
+        static constexpr int64_t kDefaultFrameIntervalNs = 16666667;
+        static constexpr int64_t kGpuPollsPerInterval = 4;
+
+        explicit FrameScheduler(SchedulerPlatform *platform, int64_t frameIntervalNs = kDefaultFrameIntervalNs);
+
+        // Continuous frames run only while active, e.g. while the window is shown.
+        void SetActive(bool active);
+        bool Active() const { return mActive; }
+        // Passed to SubmitFrame() for every scheduled frame.
+        void SetFrameCallback(FrameCallback callback) { mCallback = std::move(callback); }
+        // Makes Run() return after the current iteration; callable from callbacks.
+        void Stop() { mStopped = true; }
+
+        // Loops until Stop() or the platform asks to exit.
+        void Run();
+        // One iteration: deliver finished frames, submit one if due, then wait.
+        bool RunOnce();
+
+        SchedulerStats GetStats() const { return mStats; }
+
+    private:
+        SchedulerPlatform *mPlatform;
+        int64_t mFrameIntervalNs;
+        int64_t mNextFrameNs = 0;
+        bool mActive = false;
+        bool mStopped = false;
+        FrameCallback mCallback;
+        SchedulerStats mStats = {};
+    };
+
+    // Platform whose clock only moves when the scheduler waits, so it runs
+    // through any number of frame intervals instantly and deterministically.
+    class FakeSchedulerPlatform : public SchedulerPlatform
+    {
+    public:
+        int64_t NowNs() override { return mNowNs; }
+        // Advances the clock by the timeout; an unbounded wait could never
+        // end, so it exits the loop instead.
+        bool Wait(int64_t timeoutNs) override;
+
+    private:
+        int64_t mNowNs = 0;
+    };
+}
+
+#endif // define __DAWN_ANDROID_FRAME_SCHEDULER_H
@@ -0,0 +1,225 @@
+// Desktop entry point: runs the binning pipeline without a window, for
+// benchmarking and regression testing on build servers.
+//
+//   dawn_headless [--backend=vulkan|swiftshader|null] [--width=N] [--height=N]
+//                 [--frames=N] [--mode=atomic|subgroup|bitmap] [--profile] [--cache-dir=PATH]
+//                 [--workgroup-size=N] [--tile-size=N] [--auto-tune] [--tiling] [--compact] [--no-subgroups]
+//                 [--sorted-bin-lists] [--cull] [--scheduler] [--render-thread]
+//
+// --scheduler drives the pipelined frames through FrameScheduler on a fake
+// clock. --render-thread runs Init() and the frames on a RenderThread at
+// 60 Hz, the threading model of the Android app.
+
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <string>
+
+#include "lib.h"
+#include "util.h"
+#include "frame_scheduler.h"
+#include "render_thread.h"
+
+static bool ParseFlag(const char *arg, const char *name, const char **value)
+{
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+    {
+        return false;
+    }
+    *value = arg + length + 1;
+    return true;
+}
+
+// This thread only queues commands; it never calls into DawnAndroid itself.
+static void RunOnRenderThread(uint32_t width, uint32_t height, const DawnAndroid::Options &options, uint32_t frames)
+{
+    DawnAndroid::RenderThread renderThread;
+    std::promise<void> done;
+    std::future<void> allDelivered = done.get_future();
+    uint32_t delivered = 0;
+    renderThread.SetFrameCallback([&](const DawnAndroid::FrameResult &)
+                                  {
+                                      if (++delivered == frames)
+                                      {
+                                          done.set_value();
+                                      }
+                                  });
+    renderThread.Start();
+    renderThread.Init(width, height, options);
+    renderThread.SetActive(frames > 0);
+    if (frames > 0)
+    {
+        allDelivered.wait();
+    }
+    renderThread.SetActive(false);
+    renderThread.Stop();
+    LOGI("Render thread frames: %u\n", delivered);
+}
+
+int main(int argc, char **argv)
+{
+    DawnAndroid::Options options;
+    uint32_t width = 1080;
+    uint32_t height = 2400;
+    uint32_t frames = 10;
+    bool scheduler = false;
+    bool renderThread = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *value = nullptr;
+        if (ParseFlag(argv[i], "--backend", &value))
+        {
+            if (strcmp(value, "null") == 0)
+            {
+                options.backendType = wgpu::BackendType::Null;
+            }
+            else if (strcmp(value, "swiftshader") == 0)
+            {
+                options.backendType = wgpu::BackendType::Vulkan;
+                options.forceFallbackAdapter = true;
+            }
+            else if (strcmp(value, "vulkan") == 0)
+            {
+                options.backendType = wgpu::BackendType::Vulkan;
+            }
+            else
+            {
+                LOGE("Unknown backend %s\n", value);
+                return 1;
+            }
+        }
+        else if (ParseFlag(argv[i], "--mode", &value))
+        {
+            options.binningMode = DawnAndroid::BinningMode::Atomic;
+            if (strcmp(value, "bitmap") == 0)
+            {
+                options.binningMode = DawnAndroid::BinningMode::Bitmap;
+            }
+            else if (strcmp(value, "subgroup") == 0)
+            {
+                options.binningMode = DawnAndroid::BinningMode::Subgroup;
+            }
+        }
+        else if (ParseFlag(argv[i], "--width", &value))
+        {
+            width = atoi(value);
+        }
+        else if (ParseFlag(argv[i], "--height", &value))
+        {
+            height = atoi(value);
+        }
+        else if (ParseFlag(argv[i], "--frames", &value))
+        {
+            frames = atoi(value);
+        }
+        else if (ParseFlag(argv[i], "--cache-dir", &value))
+        {
+            options.cacheDirectory = value;
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            options.profiling = true;
+        }
+        else if (ParseFlag(argv[i], "--workgroup-size", &value))
+        {
+            options.variant.workgroupSize = atoi(value);
+        }
+        else if (ParseFlag(argv[i], "--tile-size", &value))
+        {
+            options.variant.tileSize = atoi(value);
+        }
+        else if (strcmp(argv[i], "--auto-tune") == 0)
+        {
+            options.autoTune = true;
+        }
+        else if (strcmp(argv[i], "--no-subgroups") == 0)
+        {
+            options.subgroups = false;
+        }
+        else if (strcmp(argv[i], "--compact") == 0)
+        {
+            options.compactPaths = true;
+        }
+        else if (strcmp(argv[i], "--tiling") == 0)
+        {
+            options.tiling = true;
+        }
+        else if (strcmp(argv[i], "--sorted-bin-lists") == 0)
+        {
+            options.sortedBinLists = true;
+        }
+        else if (strcmp(argv[i], "--cull") == 0)
+        {
+            options.cullPaths = true;
+        }
+        else if (strcmp(argv[i], "--scheduler") == 0)
+        {
+            scheduler = true;
+        }
+        else if (strcmp(argv[i], "--render-thread") == 0)
+        {
+            renderThread = true;
+        }
+        else
+        {
+            LOGE("Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (renderThread)
+    {
+        RunOnRenderThread(width, height, options, frames);
+    }
+    else
+    {
+        DawnAndroid::Init(width, height, options);
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            DawnAndroid::Frame();
+        }
+
+        if (scheduler)
+        {
+            DawnAndroid::FakeSchedulerPlatform platform;
+            DawnAndroid::FrameScheduler frameScheduler(&platform);
+            uint32_t delivered = 0;
+            frameScheduler.SetFrameCallback([&](const DawnAndroid::FrameResult &)
+                                            {
+                                                if (++delivered == frames)
+                                                {
+                                                    frameScheduler.SetActive(false);
+                                                }
+                                            });
+            frameScheduler.SetActive(frames > 0);
+            // Returns once inactive with nothing left on the GPU.
+            frameScheduler.Run();
+
+            DawnAndroid::SchedulerStats schedulerStats = frameScheduler.GetStats();
+            LOGI("Scheduled frames: %llu, %llu dropped, %llu wakeups over %.2f ms of fake time\n",
+                 static_cast<unsigned long long>(schedulerStats.frames), static_cast<unsigned long long>(schedulerStats.droppedFrames),
+                 static_cast<unsigned long long>(schedulerStats.wakeups), platform.NowNs() / 1e6);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < frames; i++)
+            {
+                DawnAndroid::SubmitFrame(nullptr);
+            }
+        }
+        DawnAndroid::WaitForFrames();
+    }
+
+    DawnAndroid::FrameStats stats = DawnAndroid::GetFrameStats();
+    LOGI("Binning kernel: %s\n", DawnAndroid::GetBinningKernelName());
+    LOGI("Time to first frame: %.2f ms\n", DawnAndroid::TimeToFirstFrameMs());
+    LOGI("Blocking frames: %llu, %.2f ms waiting\n", static_cast<unsigned long long>(stats.blockingFrames), stats.blockingWaitMs);
+    LOGI("Pipelined frames: %llu, %.2f ms waiting, %.2f ms CPU time saved\n",
+         static_cast<unsigned long long>(stats.pipelinedFrames), stats.pipelinedWaitMs, stats.cpuTimeSavedMs);
+    DawnAndroid::FrameArenaStats arenaStats = DawnAndroid::GetFrameArena().GetStats();
+    LOGI("Frame arena: %zu bytes peak, %llu chunk allocations over %llu frames\n",
+         arenaStats.peakBytes, static_cast<unsigned long long>(arenaStats.chunkAllocations), static_cast<unsigned long long>(arenaStats.resets));
+    return 0;
+}
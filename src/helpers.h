@@ -1,30 +1,343 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <unordered_map>
 #include <thread>
 #include <chrono>
 
 #include "dawn/webgpu_cpp.h"
 
+#include "frame_arena.h"
+
+// Reusable MapRead|CopyDst staging buffers, bucketed into power of two size
+// classes. Each class is a FIFO ring, so a released buffer is the last one to
+// be handed out again and has the most time to finish unmapping.
+class ReadbackPool {
+public:
+  static constexpr uint64_t kMinSize = 256;
+
+  void Init(const wgpu::Device& device) {
+    mDevice = device;
+    mRings.clear();
+  }
+
+  static uint64_t SizeClass(uint64_t byteSize) {
+    uint64_t size = kMinSize;
+    while (size < byteSize) {
+      size *= 2;
+    }
+    return size;
+  }
+
+  wgpu::Buffer Acquire(uint64_t byteSize) {
+    uint64_t size = SizeClass(byteSize);
+    std::deque<wgpu::Buffer>& ring = mRings[size];
+    if (!ring.empty()) {
+      wgpu::Buffer buffer = std::move(ring.front());
+      ring.pop_front();
+      return buffer;
+    }
+
+    wgpu::BufferDescriptor desc;
+    desc.size = size;
+    desc.usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead;
+    desc.mappedAtCreation = false;
+    desc.label = "ReadbackBuffer";
+    mAllocations++;
+    return mDevice.CreateBuffer(&desc);
+  }
+
+  // `buffer` must be unmapped.
+  void Release(wgpu::Buffer buffer) {
+    mRings[buffer.GetSize()].push_back(std::move(buffer));
+  }
+
+  // Records the copy into the caller's encoder, so the readback shares the
+  // caller's submit.
+  wgpu::Buffer RecordCopy(wgpu::CommandEncoder& encoder, const wgpu::Buffer& fromBuffer, uint64_t byteSize) {
+    wgpu::Buffer buffer = Acquire(byteSize);
+    encoder.CopyBufferToBuffer(fromBuffer, 0, buffer, 0, byteSize);
+    return buffer;
+  }
+
+  // Number of staging buffers created so far; flat in steady state.
+  uint64_t Allocations() const {
+    return mAllocations;
+  }
+
+private:
+  wgpu::Device mDevice;
+  std::unordered_map<uint64_t, std::deque<wgpu::Buffer>> mRings;
+  uint64_t mAllocations = 0;
+};
+
+// Ring of MapWrite|CopySrc staging buffers for streaming uploads. A buffer is
+// written while mapped, unmapped and copied into its destination in the
+// caller's encoder, then remapped for writing once that submit has executed,
+// so steady state uploads neither allocate nor go through WriteBuffer.
+class UploadRing {
+public:
+  static constexpr size_t kMaxBuffers = 4;
+
+  void Init(const wgpu::Device& device) {
+    // Unmap cancels pending remaps, so no callback outlives its slot.
+    for (Slot& slot : mSlots) {
+      if (slot.state == State::Remapping) {
+        slot.buffer.Unmap();
+      }
+    }
+    mDevice = device;
+    mSlots.clear();
+    mCurrent = nullptr;
+  }
+
+  // Mapped staging memory for at least `byteSize` bytes, valid until
+  // RecordCopy(). Waits for a buffer to be remapped when the ring is full.
+  void* Acquire(uint64_t byteSize) {
+    uint64_t size = ReadbackPool::SizeClass(byteSize);
+    while (true) {
+      Slot* smallest = nullptr;
+      for (Slot& slot : mSlots) {
+        if (slot.state != State::Mapped && slot.state != State::Lost) {
+          continue;
+        }
+        if (slot.state == State::Mapped && slot.buffer.GetSize() >= size) {
+          return Begin(slot);
+        }
+        if (!smallest || slot.buffer.GetSize() < smallest->buffer.GetSize()) {
+          smallest = &slot;
+        }
+      }
+
+      // Replace the smallest idle buffer once the ring is full, so the ring
+      // grows along with the uploads instead of holding on to stale sizes.
+      if (mSlots.size() < kMaxBuffers) {
+        mSlots.emplace_back();
+        return Begin(Create(mSlots.back(), size));
+      }
+      if (smallest) {
+        if (smallest->state == State::Mapped) {
+          smallest->buffer.Unmap();
+        }
+        return Begin(Create(*smallest, size));
+      }
+
+      mDevice.Tick();
+      std::this_thread::sleep_for(std::chrono::microseconds{ 50 });
+    }
+  }
+
+  // Unmaps the staging buffer from the last Acquire() and copies its first
+  // `byteSize` bytes to `dst` at `dstOffset`.
+  void RecordCopy(wgpu::CommandEncoder& encoder, const wgpu::Buffer& dst, uint64_t dstOffset, uint64_t byteSize) {
+    mCurrent->buffer.Unmap();
+    encoder.CopyBufferToBuffer(mCurrent->buffer, 0, dst, dstOffset, byteSize);
+    mCurrent->state = State::Recorded;
+    mCurrent = nullptr;
+  }
+
+  // Call after the encoder from RecordCopy() has been submitted.
+  void Submitted() {
+    for (Slot& slot : mSlots) {
+      if (slot.state != State::Recorded) {
+        continue;
+      }
+      slot.state = State::Remapping;
+      slot.buffer.MapAsync(wgpu::MapMode::Write, 0, slot.buffer.GetSize(), OnRemapped, &slot);
+    }
+  }
+
+  // Number of staging buffers created so far; flat in steady state.
+  uint64_t Allocations() const {
+    return mAllocations;
+  }
+
+private:
+  enum class State { Mapped, Writing, Recorded, Remapping, Lost };
+
+  struct Slot {
+    wgpu::Buffer buffer;
+    State state = State::Lost;
+  };
+
+  Slot& Create(Slot& slot, uint64_t size) {
+    wgpu::BufferDescriptor desc;
+    desc.size = size;
+    desc.usage = wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::MapWrite;
+    desc.mappedAtCreation = true;
+    desc.label = "UploadBuffer";
+    slot.buffer = mDevice.CreateBuffer(&desc);
+    slot.state = State::Mapped;
+    mAllocations++;
+    return slot;
+  }
+
+  void* Begin(Slot& slot) {
+    slot.state = State::Writing;
+    mCurrent = &slot;
+    return slot.buffer.GetMappedRange(0, slot.buffer.GetSize());
+  }
+
+  static void OnRemapped(WGPUBufferMapAsyncStatus status, void* userdata) {
+    Slot& slot = *static_cast<Slot*>(userdata);
+    slot.state = status == WGPUBufferMapAsyncStatus_Success ? State::Mapped : State::Lost;
+  }
+
+  wgpu::Device mDevice;
+  // A deque keeps the slots in place for the map callbacks.
+  std::deque<Slot> mSlots;
+  Slot* mCurrent = nullptr;
+  uint64_t mAllocations = 0;
+};
+
+// Read-only view of a mapped buffer. The buffer is unmapped, and handed back
+// to its pool if it came from one, when the view goes away.
+template<typename T>
+class MappedView {
+public:
+  MappedView() = default;
+  MappedView(wgpu::Buffer buffer, size_t count, ReadbackPool* pool = nullptr)
+    : mBuffer(std::move(buffer)), mCount(count), mPool(pool) {
+    mData = static_cast<const T*>(mBuffer.GetConstMappedRange(0, count * sizeof(T)));
+  }
+  ~MappedView() {
+    Reset();
+  }
+
+  MappedView(const MappedView&) = delete;
+  MappedView& operator=(const MappedView&) = delete;
+  MappedView(MappedView&& other) {
+    *this = std::move(other);
+  }
+  MappedView& operator=(MappedView&& other) {
+    if (this != &other) {
+      Reset();
+      std::swap(mBuffer, other.mBuffer);
+      std::swap(mData, other.mData);
+      std::swap(mCount, other.mCount);
+      std::swap(mPool, other.mPool);
+    }
+    return *this;
+  }
+
+  void Reset() {
+    if (mBuffer) {
+      mBuffer.Unmap();
+      if (mPool) {
+        mPool->Release(std::move(mBuffer));
+      }
+    }
+    mBuffer = nullptr;
+    mData = nullptr;
+    mCount = 0;
+    mPool = nullptr;
+  }
+
+  explicit operator bool() const { return mData != nullptr; }
+  const T* data() const { return mData; }
+  size_t size() const { return mCount; }
+  const T& operator[](size_t i) const { return mData[i]; }
+  const T* begin() const { return mData; }
+  const T* end() const { return mData + mCount; }
+
+private:
+  wgpu::Buffer mBuffer;
+  const T* mData = nullptr;
+  size_t mCount = 0;
+  ReadbackPool* mPool = nullptr;
+};
+
+struct MapReadRequest {
+  wgpu::Buffer buffer;
+  uint32_t byteSize;
+  // Pool the buffer goes back to once its view is destroyed.
+  ReadbackPool* pool = nullptr;
+};
+
+// Completion of one MapAsync. Statuses are recycled through a free list, so
+// steady state readbacks allocate nothing; maps are issued and their
+// callbacks run on the thread that ticks the device. A map that outlives the
+// wait in MapReadBuffers() is abandoned: its callback, which may fire during
+// any later Tick(), then hands the buffer back to its pool and recycles the
+// status, and only the wait that finds the free list empty allocates.
+struct MapReadStatus {
+  WGPUBufferMapAsyncStatus status = WGPUBufferMapAsyncStatus_Unknown;
+  bool abandoned = false;
+  wgpu::Buffer buffer;
+  ReadbackPool* pool = nullptr;
+
+  static MapReadStatus* Acquire(const MapReadRequest& request) {
+    std::vector<std::unique_ptr<MapReadStatus>>& freeList = FreeList();
+    MapReadStatus* self = nullptr;
+    if (freeList.empty()) {
+      self = new MapReadStatus();
+    } else {
+      self = freeList.back().release();
+      freeList.pop_back();
+    }
+    self->status = WGPUBufferMapAsyncStatus_Unknown;
+    self->abandoned = false;
+    self->buffer = request.buffer;
+    self->pool = request.pool;
+    return self;
+  }
+
+  // Returns the buffer to its pool when it is not mapped, i.e. unless a
+  // view took it over.
+  static void Recycle(MapReadStatus* self, bool releaseBuffer) {
+    if (releaseBuffer && self->pool) {
+      self->pool->Release(std::move(self->buffer));
+    }
+    self->buffer = nullptr;
+    self->pool = nullptr;
+    FreeList().emplace_back(self);
+  }
+
+  static void OnMapped(WGPUBufferMapAsyncStatus status, void* userdata) {
+    MapReadStatus* self = static_cast<MapReadStatus*>(userdata);
+    if (self->abandoned) {
+      // MapReadBuffers() unmapped the buffer when it gave up on it.
+      Recycle(self, true);
+      return;
+    }
+    self->status = status;
+  }
+
+private:
+  static std::vector<std::unique_ptr<MapReadStatus>>& FreeList() {
+    static std::vector<std::unique_ptr<MapReadStatus>> freeList;
+    return freeList;
+  }
+};
+
+// Maps all buffers for reading behind a single wait. A view is empty if its
+// map failed or timed out; timed out maps are cancelled. Buffers of failed
+// and timed out maps still go back to their pool. The result comes out of
+// `arena` when given, and then only lives until it is reset.
 template<typename T>
-std::vector<T> ReadBackBuffer(
+DawnAndroid::FrameVector<MappedView<T>> MapReadBuffers(
   const wgpu::Device& device, 
-  const wgpu::Buffer& fromBuffer, 
-  uint32_t byteSize
+  const MapReadRequest* requests,
+  size_t count,
+  DawnAndroid::FrameArena* arena = nullptr
 ) {
-  WGPUBufferMapAsyncStatus readStatus = WGPUBufferMapAsyncStatus_Unknown;
-  fromBuffer.MapAsync(
-      wgpu::MapMode::Read, 
-      0, 
-      byteSize, 
-      [](WGPUBufferMapAsyncStatus status, void * userdata) {
-          *static_cast<bool*>(userdata) = status;
-      }, 
-      &readStatus
-  );
+  DawnAndroid::FrameVector<MapReadStatus*> statuses(count, nullptr, arena);
+  for (size_t i = 0; i < count; i++) {
+    statuses[i] = MapReadStatus::Acquire(requests[i]);
+    requests[i].buffer.MapAsync(wgpu::MapMode::Read, 0, requests[i].byteSize, MapReadStatus::OnMapped, statuses[i]);
+  }
+
+  auto pending = [&statuses]() {
+    return std::any_of(statuses.begin(), statuses.end(), [](const MapReadStatus* status) {
+      return status->status == WGPUBufferMapAsyncStatus_Unknown;
+    });
+  };
 
   uint32_t iterations = 0;
-  while (readStatus == WGPUBufferMapAsyncStatus_Unknown) {
+  while (pending()) {
       #ifndef __EMSCRIPTEN__
       device.Tick();
       std::this_thread::sleep_for(std::chrono::microseconds{ 50 });
@@ -35,55 +348,93 @@ std::vector<T> ReadBackBuffer(
       }
   }
 
-  if (readStatus == WGPUBufferMapAsyncStatus_Success) {
-      const T* data = static_cast<const T*>(fromBuffer.GetConstMappedRange());
-      fromBuffer.Unmap();
-      return { &data[0], &data[byteSize / sizeof(T)] };
+  DawnAndroid::FrameVector<MappedView<T>> views(count, arena);
+  for (size_t i = 0; i < count; i++) {
+    MapReadStatus* status = statuses[i];
+    if (status->status == WGPUBufferMapAsyncStatus_Unknown) {
+      // Unmapping cancels the map, which may or may not run the callback
+      // right away; either way it owns `status` from here on.
+      status->abandoned = true;
+      requests[i].buffer.Unmap();
+      continue;
+    }
+    bool mapped = status->status == WGPUBufferMapAsyncStatus_Success;
+    if (mapped) {
+      views[i] = MappedView<T>(requests[i].buffer, requests[i].byteSize / sizeof(T), requests[i].pool);
+    } else {
+      LOGE("Failed to read back buffer, with status: %d\n", static_cast<int>(status->status));
+    }
+    MapReadStatus::Recycle(status, !mapped);
   }
-
-  LOGE("Failed to read back buffer, with status: %d\n", static_cast<int>(readStatus));
-  return { T() };
+  return views;
 }
 
 template<typename T>
-std::vector<T> CopyReadBackBuffer(
+MappedView<T> MapReadBuffer(
   const wgpu::Device& device, 
   const wgpu::Buffer& fromBuffer, 
-  uint32_t byteSize
+  uint32_t byteSize,
+  ReadbackPool* pool = nullptr,
+  DawnAndroid::FrameArena* arena = nullptr
 ) {
-  wgpu::BufferDescriptor desc;
-  desc.size = byteSize;
-  desc.usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead;  
-  desc.mappedAtCreation = false;
-  desc.label = "ReadbackBuffer";
+  MapReadRequest request = {fromBuffer, byteSize, pool};
+  return std::move(MapReadBuffers<T>(device, &request, 1, arena)[0]);
+}
 
-  wgpu::Buffer copyBuffer = device.CreateBuffer(&desc);
+template<typename T>
+DawnAndroid::FrameVector<T> ReadBackBuffer(
+  const wgpu::Device& device, 
+  const wgpu::Buffer& fromBuffer, 
+  uint32_t byteSize,
+  DawnAndroid::FrameArena* arena = nullptr
+) {
+  MappedView<T> view = MapReadBuffer<T>(device, fromBuffer, byteSize, nullptr, arena);
+  if (!view) {
+    return DawnAndroid::FrameVector<T>(1, T(), arena);
+  }
+  return DawnAndroid::FrameVector<T>(view.begin(), view.end(), arena);
+}
 
+template<typename T>
+DawnAndroid::FrameVector<T> CopyReadBackBuffer(
+  const wgpu::Device& device, 
+  ReadbackPool& pool,
+  const wgpu::Buffer& fromBuffer, 
+  uint32_t byteSize,
+  DawnAndroid::FrameArena* arena = nullptr
+) {
   wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
-  encoder.CopyBufferToBuffer(fromBuffer, 0, copyBuffer, 0, byteSize);
+  wgpu::Buffer copyBuffer = pool.RecordCopy(encoder, fromBuffer, byteSize);
   wgpu::CommandBuffer commandBuffer = encoder.Finish();
   
   commandBuffer.SetLabel("ReadBackCommandBuffer");
   auto queue = device.GetQueue();
   queue.Submit(1, &commandBuffer);  
 
-  std::vector<T> vv = std::move(ReadBackBuffer<T>(device, copyBuffer, byteSize));
-  copyBuffer.Destroy(); 
-
-  return vv;
+  // The view hands the buffer back to the pool, and so does the callback
+  // of a map that failed or timed out.
+  MappedView<T> view = MapReadBuffer<T>(device, copyBuffer, byteSize, &pool, arena);
+  if (!view) {
+    return DawnAndroid::FrameVector<T>(1, T(), arena);
+  }
+  return DawnAndroid::FrameVector<T>(view.begin(), view.end(), arena);
 }
 
-wgpu::ComputePipeline CreatePipeline(const wgpu::Device &device, const wgpu::BindGroupLayout &bgl,
-                                        const std::string &shader, const char *label)
+// Compiles from scratch; go through PipelineCache unless that is the intent.
+inline wgpu::ComputePipeline CreatePipeline(const wgpu::Device &device, const wgpu::BindGroupLayout &bgl,
+                                        const std::string &shader, const char *label,
+                                        const char *entryPoint = "main",
+                                        const std::vector<wgpu::ConstantEntry> &constants = {})
 {
     wgpu::ShaderModule shaderModule = dawn::utils::CreateShaderModule(device, shader.c_str());
     wgpu::PipelineLayout pl = dawn::utils::MakeBasicPipelineLayout(device, &bgl);
     wgpu::ComputePipelineDescriptor csDesc;
     csDesc.layout = pl;
     csDesc.compute.module = shaderModule;
-    csDesc.compute.entryPoint = "main";
+    csDesc.compute.entryPoint = entryPoint;
     csDesc.label = label;
-    csDesc.compute.constantCount = 0;
+    csDesc.compute.constantCount = constants.size();
+    csDesc.compute.constants = constants.data();
     return device.CreateComputePipeline(&csDesc);
 }
 
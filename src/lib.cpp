@@ -15,18 +15,26 @@
 #include "lib.h"
 #include "util.h"
 #include "helpers.h"
+#include "cpu_binner.h"
+#include "pipeline_cache.h"
+#include "profiler.h"
+#include "radix_sort.h"
 
 #include <vector>
 #include <algorithm>
 #include <iostream>
 #include <utility>
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
 #include <chrono>
 #include <thread>
+#include <cstring>
+#include <fstream>
+#include <bit>
 
-static const wgpu::BackendType backendType = wgpu::BackendType::Vulkan;
-
-static const char *shader = R"(
+// Declarations shared by all binning kernels.
+static const char *binningCommon = R"(
 // SPDX-License-Identifier: Apache-2.0 OR MIT OR Unlicense
 
 struct PathInfo {
@@ -36,23 +44,27 @@ struct PathInfo {
 
 struct ComputeUniforms {
     path_count: u32,
+    width: u32,
+    height: u32,
 }
 
-@group(0) @binding(0) var<storage, read> path_info: array<PathInfo>;
-@group(0) @binding(1) var<storage, read_write> bin_header: array<atomic<u32>>;
-@group(0) @binding(2) var<uniform> compute_uniforms: ComputeUniforms;
-
-const WG_SIZE = 256u;
-const N_TILE = 256u;
-const TILE_SIZE = 16u;
-const uniform_width = 1080u;
-
-var<workgroup> sh_counts: array<atomic<u32>, 256>;
+// Pipeline overrides, see BinningVariant. N_TILE is kept at kNumBins since
+// it fixes the bin_header layout.
+override WG_SIZE: u32 = 256u;
+override N_TILE: u32 = 256u;
+override TILE_SIZE: u32 = 16u;
 
 fn div_up(v: u32, c: u32) -> u32 {
     return (v + (c - 1u)) / c; 
 }
 
+// Bin grid for the viewport, clamped so that it fits in N_TILE bins.
+fn bin_grid() -> vec2<u32> {
+    let w = clamp(div_up(div_up(compute_uniforms.width, TILE_SIZE), TILE_SIZE), 1u, N_TILE);
+    let h = min(div_up(div_up(compute_uniforms.height, TILE_SIZE), TILE_SIZE), N_TILE / w);
+    return vec2(w, h);
+}
+
 struct TRBLRect{
     t: u32,
     r: u32,
@@ -68,172 +80,2573 @@ fn get_trbl_rect(tl: u32, br: u32) -> TRBLRect {
     return TRBLRect(t, r, b, l);
 }
 
-@compute @workgroup_size(256)
+// Range of bins (x0, y0, x1, y1) covered by a path area in tiles.
+fn bin_rect(path_area: TRBLRect, grid: vec2<u32>) -> vec4<u32> {
+    let x0 = min(path_area.l / TILE_SIZE, grid.x);
+    let y0 = min(path_area.t / TILE_SIZE, grid.y);
+    let x1 = min(div_up(path_area.r, TILE_SIZE), grid.x);
+    var y1 = min(div_up(path_area.b, TILE_SIZE), grid.y);
+
+    if x0 == x1 {
+        y1 = y0;
+    }
+    return vec4(x0, y0, x1, y1);
+}
+
+// Number of bins in a bin_rect(). A path box with l > r or t > b gives an
+// inverted rect, which is empty like in CpuBin(); the unsigned products
+// would otherwise wrap.
+fn bin_rect_area(rect: vec4<u32>) -> u32 {
+    return select(0u, (rect.z - rect.x) * (rect.w - rect.y), rect.z > rect.x && rect.w > rect.y);
+}
+
+// Bins covered by a path, empty past the end of the scene. path_area()
+// comes from the path source the kernel is built with.
+fn path_bin_rect(element_ix: u32, grid: vec2<u32>) -> vec4<u32> {
+    return bin_rect(path_area(element_ix), grid);
+}
+)";
+
+// Bindings of the full binning kernels.
+static const char *binningBindings = R"(
+@group(0) @binding(1) var<storage, read_write> bin_header: array<u32>;
+@group(0) @binding(2) var<uniform> compute_uniforms: ComputeUniforms;
+@group(0) @binding(3) var<storage, read_write> bin_bitmap: array<u32>;
+)";
+
+// Path sources bind the scene at binding 0 and provide path_area().
+// PathEntry is the element type of path_info.
+static const char *pathInfoSource = R"(
+alias PathEntry = PathInfo;
+
+@group(0) @binding(0) var<storage, read> path_info: array<PathInfo>;
+
+// Bounding box of a path in tiles, empty past the end of the scene.
+fn path_area(element_ix: u32) -> TRBLRect {
+    if element_ix < compute_uniforms.path_count {
+        let info = path_info[element_ix];
+        return get_trbl_rect(info.bb_tl, info.bb_br);
+    }
+    return TRBLRect(0u, 0u, 0u, 0u);
+}
+)";
+
+// Compact path format, see EncodeCompactPath(): one u32 per path holding
+// l, t, r, b as 8-bit tile coordinates clamped to the bin grid extent.
+// Clamping does not change which bins or tiles a path covers.
+static const char *compactPathCodec = R"(
+fn encode_compact_path(area: TRBLRect) -> u32 {
+    let extent = bin_grid() * TILE_SIZE;
+    return min(area.l, extent.x) | (min(area.t, extent.y) << 8u) |
+           (min(area.r, extent.x) << 16u) | (min(area.b, extent.y) << 24u);
+}
+
+fn decode_compact_path(word: u32) -> TRBLRect {
+    return TRBLRect((word >> 8u) & 0xffu, (word >> 16u) & 0xffu, word >> 24u, word & 0xffu);
+}
+)";
+
+static const char *compactPathSource = R"(
+alias PathEntry = u32;
+
+@group(0) @binding(0) var<storage, read> path_info: array<u32>;
+
+fn path_area(element_ix: u32) -> TRBLRect {
+    if element_ix < compute_uniforms.path_count {
+        return decode_compact_path(path_info[element_ix]);
+    }
+    return TRBLRect(0u, 0u, 0u, 0u);
+}
+)";
+
+// Writable scene binding of the incremental kernel, per path format.
+static const char *pathInfoStore = R"(
+@group(0) @binding(0) var<storage, read_write> path_info: array<PathInfo>;
+
+fn store_path(element_ix: u32, info: PathInfo) {
+    path_info[element_ix] = info;
+}
+)";
+
+static const char *compactPathStore = R"(
+@group(0) @binding(0) var<storage, read_write> path_info: array<u32>;
+
+fn store_path(element_ix: u32, info: PathInfo) {
+    path_info[element_ix] = encode_compact_path(get_trbl_rect(info.bb_tl, info.bb_br));
+}
+)";
+
+// One shared memory atomic per covered bin per path.
+static const char *atomicBinningShader = R"(
+override N_WORDS: u32 = N_TILE / 32u;
+// Paths covering more bins than this are split across the workgroup.
+const SPLIT_AREA: u32 = 4u;
+
+var<workgroup> sh_counts: array<atomic<u32>, N_TILE>;
+var<workgroup> sh_bitmap: array<atomic<u32>, N_WORDS>;
+// Inclusive prefix sum of the bin counts of split paths, and their bin
+// rects packed as (x0 | y0 << 16, x1 | y1 << 16).
+var<workgroup> sh_split_offsets: array<u32, WG_SIZE>;
+var<workgroup> sh_split_rects: array<vec2<u32>, WG_SIZE>;
+
+@compute @workgroup_size(WG_SIZE)
 fn main(
     @builtin(global_invocation_id) global_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
     @builtin(workgroup_id) wg_id: vec3<u32>,
 ) {
-    atomicStore(&sh_counts[local_id.x], 0u);   
+    for (var bin = local_id.x; bin < N_TILE; bin += WG_SIZE) {
+        atomicStore(&sh_counts[bin], 0u);
+    }
+    if local_id.x < N_TILE / 32u {
+        atomicStore(&sh_bitmap[local_id.x], 0u);
+    }
     workgroupBarrier();
-    let element_ix = global_id.x;
-    
-    var path_area = TRBLRect(0u, 0u, 0u, 0u);
-    if element_ix < 303u {
-        let info = path_info[element_ix];
-        path_area = get_trbl_rect(info.bb_tl, info.bb_br);
+    let grid = bin_grid();
+    let rect = path_bin_rect(global_id.x, grid);
+    let area = bin_rect_area(rect);
+
+    // Small paths are counted by their own invocation.
+    var split_area = 0u;
+    if area <= SPLIT_AREA {
+        for (var y = rect.y; y < rect.w; y++) {
+            for (var x = rect.x; x < rect.z; x++) {
+                atomicAdd(&sh_counts[y * grid.x + x], 1u);
+            }
+        }
+    } else {
+        split_area = area;
     }
 
-    let width_in_bins = div_up(div_up(uniform_width, TILE_SIZE), TILE_SIZE);
-    
-    let x0 = path_area.l / TILE_SIZE;
-    let y0 = path_area.t / TILE_SIZE;
-    let x1 = div_up(path_area.r, TILE_SIZE) * u32(element_ix < 303u);
-    var y1 = div_up(path_area.b, TILE_SIZE) * u32(element_ix < 303u);
+    // The bins of large paths are numbered by a scan over their areas and
+    // dealt out WG_SIZE at a time, so a full screen path costs every
+    // invocation the same instead of stalling one of them.
+    sh_split_rects[local_id.x] = vec2(rect.x | (rect.y << 16u), rect.z | (rect.w << 16u));
+    var offset = split_area;
+    sh_split_offsets[local_id.x] = offset;
+    for (var i = 1u; i < WG_SIZE; i <<= 1u) {
+        workgroupBarrier();
+        if local_id.x >= i {
+            offset += sh_split_offsets[local_id.x - i];
+        }
+        workgroupBarrier();
+        sh_split_offsets[local_id.x] = offset;
+    }
+    let total = workgroupUniformLoad(&sh_split_offsets[WG_SIZE - 1u]);
 
-    if x0 == x1 {
-        y1 = y0;
+    for (var item = local_id.x; item < total; item += WG_SIZE) {
+        // First path whose inclusive offset exceeds the item.
+        var lo = 0u;
+        var hi = WG_SIZE - 1u;
+        while lo < hi {
+            let mid = (lo + hi) / 2u;
+            if sh_split_offsets[mid] > item {
+                hi = mid;
+            } else {
+                lo = mid + 1u;
+            }
+        }
+        var start = 0u;
+        if lo > 0u {
+            start = sh_split_offsets[lo - 1u];
+        }
+        let packed = sh_split_rects[lo];
+        let x0 = packed.x & 0xffffu;
+        let w = (packed.y & 0xffffu) - x0;
+        let bin_ix = item - start;
+        let x = x0 + bin_ix % w;
+        let y = (packed.x >> 16u) + bin_ix / w;
+        atomicAdd(&sh_counts[y * grid.x + x], 1u);
     }
-    
+
     workgroupBarrier();
-    // --- 1 --- 
-    for (var y = y0; y < y1; y++) {
-        for (var x = x0; x < x1; x++) {
-            atomicAdd(&sh_counts[y * width_in_bins + x], 1u);
+    // Every partition owns its own slice of bin_header, so no global atomics are needed.
+    for (var bin = local_id.x; bin < N_TILE; bin += WG_SIZE) {
+        let count = atomicLoad(&sh_counts[bin]);
+        bin_header[wg_id.x * N_TILE + bin] = count;
+        if count != 0u {
+            atomicOr(&sh_bitmap[bin / 32u], 1u << (bin % 32u));
         }
     }
-    
-    // --- 2 ---
-    // if (local_id.x < 128u) {
-    //     for (var y = y0; y < y1; y++) {
-    //         for (var x = x0; x < x1; x++) {
-    //             atomicAdd(&sh_counts[y * width_in_bins + x], 1u);
-    //         }
-    //     }
-    // }
-    // workgroupBarrier();
-    // if (local_id.x >= 128u) {
-    //     for (var y = y0; y < y1; y++) {
-    //         for (var x = x0; x < x1; x++) {
-    //             atomicAdd(&sh_counts[y * width_in_bins + x], 1u);
-    //         }
-    //     }
-    // }
 
-    // --- 3 ---
-    // atomicStore(&sh_counts[local_id.x], local_id.x + 4u);
+    workgroupBarrier();
+    if local_id.x < N_TILE / 32u {
+        bin_bitmap[wg_id.x * (N_TILE / 32u) + local_id.x] = atomicLoad(&sh_bitmap[local_id.x]);
+    }
+}
+)";
+
+// Atomic binning with one shared memory atomic per subgroup instead of per
+// lane: the lanes covering a bin ballot, and the lowest of them adds the
+// popcount. Needs chromium_experimental_subgroups, see subgroupsEnable.
+static const char *subgroupBinningShader = R"(
+override N_WORDS: u32 = N_TILE / 32u;
+
+var<workgroup> sh_counts: array<atomic<u32>, N_TILE>;
+var<workgroup> sh_bitmap: array<atomic<u32>, N_WORDS>;
+// Union of the bin rects of the workgroup's non-empty paths, as
+// (x0, y0, x1, y1); sh_union is its plain copy for workgroupUniformLoad.
+var<workgroup> sh_union_min: array<atomic<u32>, 2>;
+var<workgroup> sh_union_max: array<atomic<u32>, 2>;
+var<workgroup> sh_union: vec4<u32>;
+
+// Number of lanes in `lanes` below `lane`.
+fn ballot_rank(lanes: vec4<u32>, lane: u32) -> u32 {
+    let word = lane / 32u;
+    let below = select(vec4(0u), lanes, vec4(word) > vec4(0u, 1u, 2u, 3u));
+    return dot(countOneBits(below), vec4(1u)) + countOneBits(lanes[word] & ((1u << (lane % 32u)) - 1u));
+}
+
+@compute @workgroup_size(WG_SIZE)
+fn main(
+    @builtin(global_invocation_id) global_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(workgroup_id) wg_id: vec3<u32>,
+    @builtin(subgroup_invocation_id) sg_lane: u32,
+) {
+    for (var bin = local_id.x; bin < N_TILE; bin += WG_SIZE) {
+        atomicStore(&sh_counts[bin], 0u);
+    }
+    if local_id.x < N_TILE / 32u {
+        atomicStore(&sh_bitmap[local_id.x], 0u);
+    }
+    if local_id.x < 2u {
+        atomicStore(&sh_union_min[local_id.x], 0xffffu);
+        atomicStore(&sh_union_max[local_id.x], 0u);
+    }
+    workgroupBarrier();
+    let grid = bin_grid();
+    let rect = path_bin_rect(global_id.x, grid);
+    if bin_rect_area(rect) != 0u {
+        atomicMin(&sh_union_min[0], rect.x);
+        atomicMin(&sh_union_min[1], rect.y);
+        atomicMax(&sh_union_max[0], rect.z);
+        atomicMax(&sh_union_max[1], rect.w);
+    }
+    workgroupBarrier();
+    if local_id.x == 0u {
+        sh_union = vec4(atomicLoad(&sh_union_min[0]), atomicLoad(&sh_union_min[1]),
+                        atomicLoad(&sh_union_max[0]), atomicLoad(&sh_union_max[1]));
+    }
+    let bounds = workgroupUniformLoad(&sh_union);
+
+    // Every lane visits every bin of the workgroup's union rect in the same
+    // order and ballots in uniform control flow, so a ballot holds exactly
+    // the lanes covering one bin. The union is empty when every path is, and
+    // at most N_TILE bins.
+    for (var y = bounds.y; y < bounds.w; y++) {
+        for (var x = bounds.x; x < bounds.z; x++) {
+            let covered = x >= rect.x && x < rect.z && y >= rect.y && y < rect.w;
+            let lanes = subgroupBallot(covered);
+            if covered && ballot_rank(lanes, sg_lane) == 0u {
+                atomicAdd(&sh_counts[y * grid.x + x], dot(countOneBits(lanes), vec4(1u)));
+            }
+        }
+    }
 
     workgroupBarrier();
-    let num_partitions = div_up(compute_uniforms.path_count, WG_SIZE);
-    let v = atomicLoad(&sh_counts[local_id.x]);
-    
-    // -- a ---
-    for (var i = wg_id.x; i < 2u; i++) {
-        atomicAdd(&bin_header[local_id.x * 2u + i], v);
+    for (var bin = local_id.x; bin < N_TILE; bin += WG_SIZE) {
+        let count = atomicLoad(&sh_counts[bin]);
+        bin_header[wg_id.x * N_TILE + bin] = count;
+        if count != 0u {
+            atomicOr(&sh_bitmap[bin / 32u], 1u << (bin % 32u));
+        }
     }
 
-    // --- b ---
-    // for (var i = 0u; i < 2u; i++) {
-    //     atomicAdd(&bin_header[local_id.x * 2u + i], v);
-    // }
+    workgroupBarrier();
+    if local_id.x < N_TILE / 32u {
+        bin_bitmap[wg_id.x * (N_TILE / 32u) + local_id.x] = atomicLoad(&sh_bitmap[local_id.x]);
+    }
 }
 )";
 
-namespace DawnAndroid
-{
-    dawn::native::Instance instance;
-    wgpu::Device device;
+// Has to come before any other declaration of the module.
+static const char *subgroupsEnable = "enable chromium_experimental_subgroups;\n";
 
-    wgpu::Buffer pathAreaBuffer;
-    wgpu::Buffer outputBuffer;
-    wgpu::Buffer uniformBuffer;
+// Row and column bitmaps of a partition's paths. Every bin row and bin
+// column gets a bitmap of the paths that overlap it, so the paths covering
+// bin (x, y) are row[y] & col[x].
+static const char *partitionLinesShader = R"(
+override N_SLICE: u32 = WG_SIZE / 32u;
+override N_LINES: u32 = (N_TILE + 1u) * N_SLICE;
 
-    wgpu::ComputePipeline pipeline;
-    wgpu::BindGroup bindGroup;
+// Rows first, then columns; w + h <= N_TILE + 1 since w * h <= N_TILE.
+var<workgroup> sh_lines: array<u32, N_LINES>;
+var<workgroup> sh_rects: array<vec2<u32>, WG_SIZE>;
 
-    void PrintDeviceError(WGPUErrorType errorType, const char *message, void *)
-    {
-        printf("%s error: %s", "Unknown", message);
+// `rect` is the bin rect of this invocation's path. Must be called from
+// uniform control flow.
+fn build_partition_lines(local_ix: u32, rect: vec4<u32>, grid: vec2<u32>) {
+    // x range in the low half, y range in the high half of each component.
+    sh_rects[local_ix] = vec2(rect.x | (rect.y << 16u), rect.z | (rect.w << 16u));
+    workgroupBarrier();
+
+    // Lines [0, h) are the row bitmaps, lines [h, h + w) the column bitmaps.
+    for (var line = local_ix; line < grid.y + grid.x; line += WG_SIZE) {
+        let is_row = line < grid.y;
+        let coord = select(line - grid.y, line, is_row);
+        let shift = select(0u, 16u, is_row);
+        for (var slice = 0u; slice < N_SLICE; slice++) {
+            var bits = 0u;
+            for (var i = 0u; i < 32u; i++) {
+                let r = sh_rects[slice * 32u + i];
+                let lo = (r.x >> shift) & 0xffffu;
+                let hi = (r.y >> shift) & 0xffffu;
+                if coord >= lo && coord < hi {
+                    bits |= 1u << i;
+                }
+            }
+            sh_lines[line * N_SLICE + slice] = bits;
+        }
     }
+    workgroupBarrier();
+}
 
-    wgpu::Device AndroidCreateDevice()
-    {
-        wgpu::RequestAdapterOptions options = {};
-        options.backendType = backendType;
-        std::vector<dawn::native::Adapter> adapters = instance.EnumerateAdapters(&options);
-        if (adapters.size() == 0)
-        {
-            std::cout << "Failed to find valid adapter" << std::endl;
-            exit(0);
+// Paths [32 * slice, 32 * slice + 32) of the partition that cover bin (x, y).
+fn bin_slice(x: u32, y: u32, slice: u32, grid: vec2<u32>) -> u32 {
+    return sh_lines[y * N_SLICE + slice] & sh_lines[(grid.y + x) * N_SLICE + slice];
+}
+)";
+
+// Atomic free variant: the count for a bin is the popcount of its row and
+// column bitmaps. The cost is independent of the path areas, which is what
+// matters when many large paths overlap.
+static const char *bitmapBinningShader = R"(
+var<workgroup> sh_flags: array<u32, N_TILE>;
+
+@compute @workgroup_size(WG_SIZE)
+fn main(
+    @builtin(global_invocation_id) global_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(workgroup_id) wg_id: vec3<u32>,
+) {
+    let grid = bin_grid();
+    build_partition_lines(local_id.x, path_bin_rect(global_id.x, grid), grid);
+
+    for (var bin = local_id.x; bin < N_TILE; bin += WG_SIZE) {
+        var count = 0u;
+        if bin < grid.x * grid.y {
+            for (var slice = 0u; slice < N_SLICE; slice++) {
+                count += countOneBits(bin_slice(bin % grid.x, bin / grid.x, slice, grid));
+            }
+        }
+        bin_header[wg_id.x * N_TILE + bin] = count;
+        // Pack the occupancy flags 32 bins at a time.
+        sh_flags[bin] = u32(count != 0u) << (bin % 32u);
+    }
+    workgroupBarrier();
+    let word_ix = local_id.x;
+    if word_ix < N_TILE / 32u {
+        var word = 0u;
+        for (var i = 0u; i < 32u; i++) {
+            word |= sh_flags[word_ix * 32u + i];
         }
+        bin_bitmap[wg_id.x * (N_TILE / 32u) + word_ix] = word;
+    }
+}
+)";
 
-        dawn::native::Adapter backendAdapter = adapters[0];
+// Applies path edits to the bin counts of the previous binning instead of
+// recounting the scene. One workgroup per partition that has edits; its
+// edits are subtracted at their old bins and added at their new ones in
+// shared memory, then the partition's slice of bin_header and bin_bitmap is
+// patched. The scene is updated in the same pass through store_path().
+static const char *incrementalBinningShader = R"(
+struct PathEdit {
+    index: u32,
+    old_info: PathInfo,
+    new_info: PathInfo,
+}
 
-        WGPUDevice device = backendAdapter.CreateDevice();
-        DawnProcTable procs = dawn::native::GetProcs();
+// Edits [begin, end) all fall into `partition`.
+struct PartitionEdits {
+    partition: u32,
+    begin: u32,
+    end: u32,
+    _padding: u32,
+}
 
-        dawnProcSetProcs(&procs);
-        procs.deviceSetUncapturedErrorCallback(device, PrintDeviceError, nullptr);
-        return wgpu::Device::Acquire(device);
+@group(0) @binding(1) var<storage, read_write> bin_header: array<u32>;
+@group(0) @binding(2) var<uniform> compute_uniforms: ComputeUniforms;
+@group(0) @binding(3) var<storage, read_write> bin_bitmap: array<u32>;
+@group(0) @binding(4) var<storage, read> edits: array<PathEdit>;
+@group(0) @binding(5) var<storage, read> partition_edits: array<PartitionEdits>;
+
+override N_WORDS: u32 = N_TILE / 32u;
+
+var<workgroup> sh_deltas: array<atomic<u32>, N_TILE>;
+var<workgroup> sh_bitmap: array<atomic<u32>, N_WORDS>;
+
+fn info_bin_rect(info: PathInfo, grid: vec2<u32>) -> vec4<u32> {
+    return bin_rect(get_trbl_rect(info.bb_tl, info.bb_br), grid);
+}
+
+@compute @workgroup_size(WG_SIZE)
+fn main(
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(workgroup_id) wg_id: vec3<u32>,
+) {
+    for (var bin = local_id.x; bin < N_TILE; bin += WG_SIZE) {
+        atomicStore(&sh_deltas[bin], 0u);
     }
+    if local_id.x < N_TILE / 32u {
+        atomicStore(&sh_bitmap[local_id.x], 0u);
+    }
+    workgroupBarrier();
+    let grid = bin_grid();
+    let range = partition_edits[wg_id.x];
 
-    void Init(uint32_t width, uint32_t height)
-    {
-        device = AndroidCreateDevice();
+    for (var i = range.begin + local_id.x; i < range.end; i += WG_SIZE) {
+        let edit = edits[i];
+        let old_rect = info_bin_rect(edit.old_info, grid);
+        for (var y = old_rect.y; y < old_rect.w; y++) {
+            for (var x = old_rect.x; x < old_rect.z; x++) {
+                atomicSub(&sh_deltas[y * grid.x + x], 1u);
+            }
+        }
+        let new_rect = info_bin_rect(edit.new_info, grid);
+        for (var y = new_rect.y; y < new_rect.w; y++) {
+            for (var x = new_rect.x; x < new_rect.z; x++) {
+                atomicAdd(&sh_deltas[y * grid.x + x], 1u);
+            }
+        }
+        store_path(edit.index, edit.new_info);
+    }
+
+    workgroupBarrier();
+    // Deltas wrap around below zero; the sum with the old count does not.
+    for (var bin = local_id.x; bin < N_TILE; bin += WG_SIZE) {
+        let ix = range.partition * N_TILE + bin;
+        let count = bin_header[ix] + atomicLoad(&sh_deltas[bin]);
+        bin_header[ix] = count;
+        if count != 0u {
+            atomicOr(&sh_bitmap[bin / 32u], 1u << (bin % 32u));
+        }
+    }
+
+    workgroupBarrier();
+    if local_id.x < N_TILE / 32u {
+        bin_bitmap[range.partition * (N_TILE / 32u) + local_id.x] = atomicLoad(&sh_bitmap[local_id.x]);
+    }
+}
+)";
+
+// Stages after binning, all fed from bin_header without a host round trip:
+// bin_offsets prefix sums the counts into per-bin path list ranges, scatter
+// writes every path into the lists of the bins it covers, in path order,
+// and coarse allocates per-tile path lists out of each bin's list. bin_paths
+// indexes path_info; tile_paths holds scene indices.
+static const char *tilingBindings = R"(
+struct TilingCounters {
+    bin_paths: u32,
+    tile_paths: atomic<u32>,
+}
 
-        pathAreaBuffer =
-            dawn::utils::CreateBufferFromData(device, pathAreaData, 512 * sizeof(uint32_t), wgpu::BufferUsage::Storage);
+@group(0) @binding(1) var<storage, read> bin_header: array<u32>;
+@group(0) @binding(2) var<uniform> compute_uniforms: ComputeUniforms;
+// Where partition p's paths of a bin start in bin_paths, at p * N_TILE + bin.
+@group(0) @binding(3) var<storage, read_write> bin_offsets: array<u32>;
+// (start, count) of every bin's list in bin_paths.
+@group(0) @binding(4) var<storage, read_write> bin_ranges: array<vec2<u32>>;
+@group(0) @binding(5) var<storage, read_write> bin_paths: array<u32>;
+// (start, count) of every tile's list in tile_paths, row major over the bin grid.
+@group(0) @binding(6) var<storage, read_write> tiles: array<vec2<u32>>;
+@group(0) @binding(7) var<storage, read_write> tile_paths: array<u32>;
+// Entries requested from bin_paths and tile_paths. Writes past the end of
+// either list are dropped and the host grows it for the next frame.
+@group(0) @binding(8) var<storage, read_write> counters: TilingCounters;
 
-        uint32_t numPaths = 303;
-        uniformBuffer = dawn::utils::CreateBufferFromData(device, &numPaths, sizeof(uint32_t), wgpu::BufferUsage::Uniform);
+struct DispatchArgs {
+    x: u32,
+    y: u32,
+    z: u32,
+}
 
-        wgpu::BufferDescriptor descriptor;
-        descriptor.size = 512 * sizeof(uint32_t);
-        descriptor.usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc;
-        outputBuffer = device.CreateBuffer(&descriptor);
+// Workgroup count of the coarse dispatch, copied into its indirect buffer.
+@group(0) @binding(9) var<storage, read_write> coarse_args: DispatchArgs;
+// Bins with at least one path; coarse runs one workgroup for each.
+@group(0) @binding(10) var<storage, read_write> occupied_bins: array<u32>;
+)";
+
+// scene_index() maps an index into path_info back to the scene, so that
+// tile lists always name scene paths. With culling path_info holds the
+// survivors, and cullShader recorded where each came from.
+static const char *sceneIndexSource = R"(
+fn scene_index(ix: u32) -> u32 {
+    return ix;
+}
+)";
+
+static const char *culledSceneIndexSource = R"(
+@group(0) @binding(11) var<storage, read> visible_indices: array<u32>;
+
+fn scene_index(ix: u32) -> u32 {
+    return visible_indices[ix];
+}
+)";
 
-        auto bgl =
-            dawn::utils::MakeBindGroupLayout(device, {
-                                                         {0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
-                                                         {1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
-                                                         {2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform},
-                                                     });
-        pipeline = CreatePipeline(device, bgl, shader, "Binning");
-        bindGroup = dawn::utils::MakeBindGroup(device, bgl, {{0, pathAreaBuffer}, {1, outputBuffer}, {2, uniformBuffer}});
+static const char *tilingShader = R"(
+var<workgroup> sh_starts: array<u32, N_TILE>;
+
+@compute @workgroup_size(WG_SIZE)
+fn bin_offsets_main(@builtin(local_invocation_id) local_id: vec3<u32>) {
+    let grid = bin_grid();
+    let n_bins = grid.x * grid.y;
+    let n_partitions = max(div_up(compute_uniforms.path_count, WG_SIZE), 1u);
+
+    // Running totals over the partitions, relative to the start of the bin.
+    for (var bin = local_id.x; bin < N_TILE; bin += WG_SIZE) {
+        var total = 0u;
+        if bin < n_bins {
+            for (var partition = 0u; partition < n_partitions; partition++) {
+                let ix = partition * N_TILE + bin;
+                bin_offsets[ix] = total;
+                total += bin_header[ix];
+            }
+        }
+        sh_starts[bin] = total;
     }
+    workgroupBarrier();
 
-    void Frame()
-    {
-        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
-        wgpu::ComputePassDescriptor descriptor;
-        wgpu::ComputePassEncoder passEncoder = encoder.BeginComputePass(&descriptor);
+    // There are at most N_TILE bins, few enough for a single lane.
+    if local_id.x == 0u {
+        var start = 0u;
+        var occupied = 0u;
+        for (var bin = 0u; bin < N_TILE; bin++) {
+            let count = sh_starts[bin];
+            bin_ranges[bin] = vec2(start, count);
+            sh_starts[bin] = start;
+            start += count;
+            if count != 0u {
+                occupied_bins[occupied] = bin;
+                occupied++;
+            }
+        }
+        counters.bin_paths = start;
+        coarse_args = DispatchArgs(occupied, 1u, 1u);
+    }
+    workgroupBarrier();
 
-        passEncoder.SetPipeline(pipeline);
-        passEncoder.SetBindGroup(0, bindGroup);
-        passEncoder.DispatchWorkgroups(1);
-        passEncoder.End();
+    for (var bin = local_id.x; bin < n_bins; bin += WG_SIZE) {
+        let start = sh_starts[bin];
+        for (var partition = 0u; partition < n_partitions; partition++) {
+            bin_offsets[partition * N_TILE + bin] += start;
+        }
+    }
+}
 
-        wgpu::CommandBuffer commands = encoder.Finish();
-        device.GetQueue().Submit(1, &commands);
+// One workgroup per partition. A path's slot in a bin's list is the number
+// of lower indexed paths of its partition in that bin, so lists stay in
+// path order without atomics.
+@compute @workgroup_size(WG_SIZE)
+fn scatter_main(
+    @builtin(global_invocation_id) global_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(workgroup_id) wg_id: vec3<u32>,
+) {
+    let grid = bin_grid();
+    let rect = path_bin_rect(global_id.x, grid);
+    build_partition_lines(local_id.x, rect, grid);
 
-        bool done = false;
-        device.GetQueue().OnSubmittedWorkDone(
-            [](WGPUQueueWorkDoneStatus status, void *userdata) -> void
-            { *(static_cast<bool *>(userdata)) = true; },
-            &done);
+    let own_slice = local_id.x / 32u;
+    let lower_mask = (1u << (local_id.x % 32u)) - 1u;
+    let n_bin_paths = arrayLength(&bin_paths);
+    for (var y = rect.y; y < rect.w; y++) {
+        for (var x = rect.x; x < rect.z; x++) {
+            var rank = countOneBits(bin_slice(x, y, own_slice, grid) & lower_mask);
+            for (var slice = 0u; slice < own_slice; slice++) {
+                rank += countOneBits(bin_slice(x, y, slice, grid));
+            }
+            let slot = bin_offsets[wg_id.x * N_TILE + y * grid.x + x] + rank;
+            if slot < n_bin_paths {
+                bin_paths[slot] = global_id.x;
+            }
+        }
+    }
+}
 
-        while (!done)
-        {
-            device.Tick();
-            std::this_thread::sleep_for(std::chrono::microseconds{1});
+override N_BIN_TILES: u32 = TILE_SIZE * TILE_SIZE;
+
+// Per-tile path counts, then the coverage masks of one chunk of paths.
+var<workgroup> sh_tile_bits: array<atomic<u32>, N_BIN_TILES>;
+// Exclusive prefix sums of the counts, then every tile's write cursor.
+var<workgroup> sh_tile_offsets: array<u32, N_BIN_TILES>;
+var<workgroup> sh_tile_base: u32;
+var<workgroup> sh_range: vec2<u32>;
+
+// Tiles of the bin at `bin_origin` that path `path_ix` covers, relative to
+// the bin and empty for an inverted box.
+fn bin_tile_rect(path_ix: u32, bin_origin: vec2<u32>) -> vec4<u32> {
+    let area = path_area(path_ix);
+    let bin_end = bin_origin + TILE_SIZE;
+    let lo = clamp(vec2(area.l, area.t), bin_origin, bin_end) - bin_origin;
+    let hi = clamp(vec2(area.r, area.b), bin_origin, bin_end) - bin_origin;
+    return vec4(lo, hi);
+}
+
+// One workgroup per occupied bin, dispatched indirectly: counts the paths of
+// every tile in the bin, takes a single allocation for the whole bin and
+// writes the tile lists in path order. Tiles of empty bins stay cleared.
+//
+// Every path visits only the tiles it covers, so the cost follows the
+// coverage of the bin instead of its tile count times its path count. The
+// counts are shared memory atomics. For the lists, chunks of 32 paths first
+// mark their tiles in a bitmask per tile, and the lane that owns a tile then
+// appends the chunk's paths in bit order, which keeps them in path order.
+@compute @workgroup_size(WG_SIZE)
+fn coarse_main(
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(workgroup_id) wg_id: vec3<u32>,
+) {
+    let grid = bin_grid();
+    let bin = occupied_bins[wg_id.x];
+
+    let bin_origin = vec2(bin % grid.x, bin / grid.x) * TILE_SIZE;
+    let width_in_tiles = grid.x * TILE_SIZE;
+
+    for (var t = local_id.x; t < N_BIN_TILES; t += WG_SIZE) {
+        atomicStore(&sh_tile_bits[t], 0u);
+    }
+    if local_id.x == 0u {
+        sh_range = bin_ranges[bin];
+    }
+    // Uniform, since the chunk loop below has barriers.
+    let range = workgroupUniformLoad(&sh_range);
+    let end = min(range.x + range.y, arrayLength(&bin_paths));
+
+    for (var i = range.x + local_id.x; i < end; i += WG_SIZE) {
+        let rect = bin_tile_rect(bin_paths[i], bin_origin);
+        for (var y = rect.y; y < rect.w; y++) {
+            for (var x = rect.x; x < rect.z; x++) {
+                atomicAdd(&sh_tile_bits[y * TILE_SIZE + x], 1u);
+            }
+        }
+    }
+    workgroupBarrier();
+
+    if local_id.x == 0u {
+        var total = 0u;
+        for (var t = 0u; t < N_BIN_TILES; t++) {
+            let count = atomicLoad(&sh_tile_bits[t]);
+            sh_tile_offsets[t] = total;
+            total += count;
         }
+        sh_tile_base = atomicAdd(&counters.tile_paths, total);
+    }
+    let base = workgroupUniformLoad(&sh_tile_base);
 
-        std::vector<uint32_t> outputData = CopyReadBackBuffer<uint32_t>(device, outputBuffer, 256 * sizeof(uint32_t));
+    // Lanes split a chunk as 32 paths times WG_SIZE / 32 rows, so a large
+    // path is spread over several lanes.
+    let lane_path = local_id.x % 32u;
+    let row_step = WG_SIZE / 32u;
+    let n_tile_paths = arrayLength(&tile_paths);
+    // From here on a lane only touches the tiles t = local_id.x (mod WG_SIZE).
+    for (var t = local_id.x; t < N_BIN_TILES; t += WG_SIZE) {
+        let tile = bin_origin + vec2(t % TILE_SIZE, t / TILE_SIZE);
+        let start = base + sh_tile_offsets[t];
+        tiles[tile.y * width_in_tiles + tile.x] = vec2(start, atomicLoad(&sh_tile_bits[t]));
+        atomicStore(&sh_tile_bits[t], 0u);
+        sh_tile_offsets[t] = start;
+    }
+    for (var chunk = range.x; chunk < end; chunk += 32u) {
+        workgroupBarrier();
+        let i = chunk + lane_path;
+        if i < end {
+            let rect = bin_tile_rect(bin_paths[i], bin_origin);
+            for (var y = rect.y + local_id.x / 32u; y < rect.w; y += row_step) {
+                for (var x = rect.x; x < rect.z; x++) {
+                    atomicOr(&sh_tile_bits[y * TILE_SIZE + x], 1u << lane_path);
+                }
+            }
+        }
+        workgroupBarrier();
 
-        for (int i = 0; i < 4; i++)
-        {
-            LOGI("%d ", outputData[i]);
+        for (var t = local_id.x; t < N_BIN_TILES; t += WG_SIZE) {
+            var bits = atomicLoad(&sh_tile_bits[t]);
+            atomicStore(&sh_tile_bits[t], 0u);
+            var slot = sh_tile_offsets[t];
+            while bits != 0u {
+                let path_ix = bin_paths[chunk + firstTrailingBit(bits)];
+                if slot < n_tile_paths {
+                    tile_paths[slot] = scene_index(path_ix);
+                }
+                slot++;
+                bits &= bits - 1u;
+            }
+            sh_tile_offsets[t] = slot;
         }
-        LOGI("\nDone\n");
+    }
+}
+)";
+
+// Viewport culling before binning. Paths that cover no bin, because their
+// box is empty or lies outside the viewport, are dropped; the survivors are
+// copied in scene order into visible_paths, which the binning kernels then
+// read as their path_info. One workgroup per partition of the scene finds
+// its output offset through a decoupled look-back over the survivor counts
+// of earlier partitions.
+static const char *cullShader = R"(
+struct DispatchArgs {
+    x: u32,
+    y: u32,
+    z: u32,
+}
+
+struct CullState {
+    // Partition index handed out in launch order, so that look-back only
+    // waits on workgroups that already run.
+    partition: atomic<u32>,
+    // Survivors before and including each partition, tagged with
+    // FLAG_AGGREGATE (this partition alone) or FLAG_PREFIX (inclusive).
+    status: array<atomic<u32>>,
+}
+
+const FLAG_AGGREGATE: u32 = 0x40000000u;
+const FLAG_PREFIX: u32 = 0x80000000u;
+const VALUE_MASK: u32 = 0x3fffffffu;
+
+@group(0) @binding(2) var<uniform> compute_uniforms: ComputeUniforms;
+// Surviving paths, padded with empty ones to a whole partition.
+@group(0) @binding(4) var<storage, read_write> visible_paths: array<PathEntry>;
+// Scene index of every surviving path, read back by coarse_main.
+@group(0) @binding(5) var<storage, read_write> visible_indices: array<u32>;
+@group(0) @binding(6) var<storage, read_write> cull_state: CullState;
+// Workgroup count of the binning dispatch, copied into its indirect buffer.
+@group(0) @binding(7) var<storage, read_write> cull_args: DispatchArgs;
+
+var<workgroup> sh_partition: u32;
+var<workgroup> sh_scan: array<u32, WG_SIZE>;
+var<workgroup> sh_base: u32;
+var<workgroup> sh_visible: u32;
+
+@compute @workgroup_size(WG_SIZE)
+fn main(@builtin(local_invocation_id) local_id: vec3<u32>) {
+    if local_id.x == 0u {
+        sh_partition = atomicAdd(&cull_state.partition, 1u);
+    }
+    let partition = workgroupUniformLoad(&sh_partition);
+    let n_partitions = max(div_up(compute_uniforms.path_count, WG_SIZE), 1u);
+
+    let ix = partition * WG_SIZE + local_id.x;
+    let rect = path_bin_rect(ix, bin_grid());
+    let visible = rect.x < rect.z && rect.y < rect.w;
+
+    var sum = u32(visible);
+    sh_scan[local_id.x] = sum;
+    for (var i = 1u; i < WG_SIZE; i <<= 1u) {
+        workgroupBarrier();
+        if local_id.x >= i {
+            sum += sh_scan[local_id.x - i];
+        }
+        workgroupBarrier();
+        sh_scan[local_id.x] = sum;
+    }
+
+    if local_id.x == WG_SIZE - 1u {
+        var exclusive = 0u;
+        if partition == 0u {
+            atomicStore(&cull_state.status[0], FLAG_PREFIX | sum);
+        } else {
+            atomicStore(&cull_state.status[partition], FLAG_AGGREGATE | sum);
+            var look = partition - 1u;
+            loop {
+                let word = atomicLoad(&cull_state.status[look]);
+                if (word & (FLAG_AGGREGATE | FLAG_PREFIX)) == 0u {
+                    continue;
+                }
+                exclusive += word & VALUE_MASK;
+                if (word & FLAG_PREFIX) != 0u {
+                    break;
+                }
+                look -= 1u;
+            }
+            atomicStore(&cull_state.status[partition], FLAG_PREFIX | (exclusive + sum));
+        }
+        sh_base = exclusive;
+        sh_visible = exclusive + sum;
+        if partition == n_partitions - 1u {
+            cull_args = DispatchArgs(div_up(exclusive + sum, WG_SIZE), 1u, 1u);
+        }
+    }
+    let base = workgroupUniformLoad(&sh_base);
+
+    if visible {
+        let slot = base + sum - 1u;
+        visible_paths[slot] = path_info[ix];
+        visible_indices[slot] = ix;
+    }
+
+    // Everything past the survivors lies beyond the slots written above.
+    if partition == n_partitions - 1u {
+        let count = sh_visible;
+        let slot = count + local_id.x;
+        if slot < div_up(count, WG_SIZE) * WG_SIZE {
+            visible_paths[slot] = PathEntry();
+        }
+    }
+}
+)";
+
+// Emits one (bin << BIN_KEY_SHIFT | path) key per bin a path covers, in
+// no particular order; sorting them yields every bin's path list in path
+// order, like the scatter stage of tilingShader.
+static const char *binKeysShader = R"(
+const BIN_KEY_SHIFT: u32 = 20u;
+
+@group(0) @binding(2) var<uniform> compute_uniforms: ComputeUniforms;
+@group(0) @binding(4) var<storage, read_write> bin_keys: array<u32>;
+// Keys requested. Writes past the end of bin_keys are dropped and the host
+// grows it for the next frame.
+@group(0) @binding(5) var<storage, read_write> bin_key_count: atomic<u32>;
+
+@compute @workgroup_size(WG_SIZE)
+fn main(@builtin(global_invocation_id) global_id: vec3<u32>) {
+    let grid = bin_grid();
+    let rect = path_bin_rect(global_id.x, grid);
+    let area = bin_rect_area(rect);
+    if area == 0u {
+        return;
+    }
+    let w = rect.z - rect.x;
+    let base = atomicAdd(&bin_key_count, area);
+    let end = min(base + area, arrayLength(&bin_keys));
+    for (var i = base; i < end; i++) {
+        let x = rect.x + (i - base) % w;
+        let y = rect.y + (i - base) / w;
+        bin_keys[i] = ((y * grid.x + x) << BIN_KEY_SHIFT) | global_id.x;
+    }
+}
+)";
+
+namespace DawnAndroid
+{
+    std::unique_ptr<CachingPlatform> cachingPlatform;
+    std::unique_ptr<dawn::native::Instance> instance;
+    wgpu::Device device;
+
+    PipelineCache pipelineCache;
+
+    wgpu::Buffer pathAreaBuffer;
+    wgpu::Buffer outputBuffer;
+    wgpu::Buffer bitmapBuffer;
+    wgpu::Buffer uniformBuffer;
+
+    ReadbackPool readbackPool;
+    UploadRing uploadRing;
+
+    bool timestampQuery = false;
+    GpuProfiler profiler;
+    // The adapter has chromium_experimental_subgroups and it was requested.
+    bool subgroups = false;
+
+    wgpu::BindGroupLayout bgl;
+    std::shared_ptr<const CachedPipeline> binningPipeline;
+    wgpu::BindGroup bindGroup;
+    std::string binningSource;
+    const char *binningLabel = nullptr;
+    // Kernel of binningSource; Subgroup only when the adapter has subgroups.
+    BinningMode binningMode = BinningMode::Atomic;
+
+    // Override constants of every binning pipeline; each variant is a
+    // separate entry in pipelineCache.
+    BinningVariant variant;
+    // Set by Options::autoTune when no winner is stored for this adapter yet.
+    bool autoTunePending = false;
+    // Set by BeginPathUpload(). Init() clears it again after loading the
+    // sample scene, so auto-tune waits for a scene of the caller's.
+    bool callerScene = false;
+    // Pipelines of every variant auto-tune times, compiling in the
+    // background while frames keep the current variant.
+    std::vector<std::shared_ptr<const CachedPipeline>> tuneCandidates;
+    std::string adapterName;
+    std::string tunedVariantsPath;
+
+    // UpdatePaths() state. The bind group is rebuilt whenever one of its
+    // buffers is reallocated.
+    wgpu::BindGroupLayout incrementalBgl;
+    std::shared_ptr<const CachedPipeline> incrementalPipeline;
+    wgpu::BindGroup incrementalBindGroup;
+    wgpu::Buffer editBuffer;
+    wgpu::Buffer partitionEditBuffer;
+    uint32_t editCapacity = 0;
+    std::vector<PathEdit> sortedEdits;
+    // Frames skip the full binning pass while bin_header matches path_info.
+    bool incrementalBinning = false;
+    bool binHeaderValid = false;
+
+    // Stages after binning, see tilingShader. The path lists grow when a
+    // frame reports that they overflowed.
+    bool tiling = false;
+    wgpu::BindGroupLayout tilingBgl;
+    std::shared_ptr<const CachedPipeline> binOffsetsPipeline;
+    std::shared_ptr<const CachedPipeline> scatterPipeline;
+    std::shared_ptr<const CachedPipeline> coarsePipeline;
+    wgpu::BindGroup tilingBindGroup;
+    wgpu::Buffer binOffsetBuffer;
+    wgpu::Buffer binRangeBuffer;
+    wgpu::Buffer binPathBuffer;
+    wgpu::Buffer tileBuffer;
+    wgpu::Buffer tilePathBuffer;
+    wgpu::Buffer tilingCounterBuffer;
+    // Coarse DispatchArgs written by bin_offsets, see Stage.
+    wgpu::Buffer tilingArgsBuffer;
+    wgpu::Buffer tilingIndirectBuffer;
+    wgpu::Buffer occupiedBinBuffer;
+    uint32_t binPathCapacity = 0;
+    uint32_t tilePathCapacity = 0;
+    uint32_t tileCapacity = 0;
+
+    // Options::cullPaths, see cullShader. Binning is then dispatched
+    // indirectly over visiblePathBuffer.
+    bool cullPaths = false;
+    wgpu::BindGroupLayout cullBgl;
+    std::shared_ptr<const CachedPipeline> cullPipeline;
+    wgpu::BindGroup cullBindGroup;
+    wgpu::Buffer visiblePathBuffer;
+    wgpu::Buffer visibleIndexBuffer;
+    wgpu::Buffer cullStateBuffer;
+    wgpu::Buffer cullArgsBuffer;
+    wgpu::Buffer cullIndirectBuffer;
+
+    // Options::sortedBinLists: binKeysShader feeds binSort in the frame's
+    // encoder. binSort also backs the sort benchmark API.
+    bool sortedBinLists = false;
+    wgpu::BindGroupLayout binKeysBgl;
+    std::shared_ptr<const CachedPipeline> binKeysPipeline;
+    wgpu::BindGroup binKeysBindGroup;
+    GpuRadixSort binSort;
+
+    ComputeUniforms uniforms = {};
+    uint32_t pathCapacity = 0;
+    uint32_t partitionCapacity = 0;
+
+    // Set when no adapter is available; Frame() then bins on the CPU.
+    bool cpuFallback = false;
+    // Host data of the current frame; reset when the next frame starts.
+    FrameArena frameArena;
+
+    // Encodes SetPathGeometry() scenes, recreated when Init() asks for a
+    // different thread count.
+    std::unique_ptr<ThreadPool> encoderPool;
+
+    // Host copy of the scene, kept while frames may run on the CPU.
+    std::vector<PathInfo> hostPaths;
+    // path_info holds one u32 per path, see EncodeCompactPath(). The
+    // encoding depends on the bin grid, so hostPaths is then always kept and
+    // re-encoded when the tile size changes.
+    bool compactPaths = false;
+
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point initStart;
+    double timeToFirstFrameMs = -1;
+
+    // Per-frame resources for SubmitFrame(); a slot is reused once its
+    // readback has been delivered.
+    struct FrameSlot
+    {
+        wgpu::Buffer readbackBuffer;
+        uint64_t readbackSize = 0;
+        uint32_t numPartitions = 0;
+        uint64_t frameIndex = 0;
+        bool inFlight = false;
+        Clock::time_point submitTime;
+        // Last time a tick found the frame still in flight; the GPU was busy
+        // with it at least until then.
+        Clock::time_point pendingAt;
+        FrameCallback callback;
+    };
+
+    FrameSlot frameSlots[kMaxFramesInFlight];
+    uint32_t nextFrameSlot = 0;
+
+    // SubmitFrame() results binned on the CPU, delivered from PollFrames()
+    // like the readbacks. Delivered headers are kept for reuse.
+    struct CpuFrame
+    {
+        uint64_t frameIndex = 0;
+        uint32_t numPartitions = 0;
+        std::vector<uint32_t> binHeader;
+        FrameCallback callback;
+    };
+
+    std::deque<CpuFrame> cpuFrames;
+    std::vector<std::vector<uint32_t>> spareCpuHeaders;
+    uint64_t frameCounter = 0;
+    FrameStats frameStats = {};
+
+    void PrintDeviceError(WGPUErrorType errorType, const char *message, void *)
+    {
+        printf("%s error: %s", "Unknown", message);
+    }
+
+    void CreateInstance(const Options &options)
+    {
+        // Dawn writes its pipeline caches through the platform while the
+        // device shuts down, so a re-Init releases the old device and
+        // instance before the platform they point to.
+        if (device)
+        {
+            device.Destroy();
+            device = nullptr;
+        }
+        instance.reset();
+        cachingPlatform.reset();
+
+        // With a cache directory, Dawn persists compiled shaders and pipeline
+        // caches through the platform's caching interface.
+        dawn::native::DawnInstanceDescriptor dawnDescriptor;
+        if (!options.cacheDirectory.empty())
+        {
+            cachingPlatform = std::make_unique<CachingPlatform>(options.cacheDirectory);
+            dawnDescriptor.platform = cachingPlatform.get();
+        }
+
+        wgpu::InstanceDescriptor descriptor;
+        descriptor.nextInChain = &dawnDescriptor;
+        instance = std::make_unique<dawn::native::Instance>(reinterpret_cast<const WGPUInstanceDescriptor *>(&descriptor));
+    }
+
+    wgpu::Device AndroidCreateDevice(const Options &options)
+    {
+        wgpu::RequestAdapterOptions adapterOptions = {};
+        adapterOptions.backendType = options.backendType;
+        adapterOptions.forceFallbackAdapter = options.forceFallbackAdapter;
+        std::vector<dawn::native::Adapter> adapters = instance->EnumerateAdapters(&adapterOptions);
+        if (adapters.size() == 0)
+        {
+            std::cout << "Failed to find valid adapter, falling back to the CPU binner" << std::endl;
+            return nullptr;
+        }
+
+        dawn::native::Adapter backendAdapter = adapters[0];
+
+        // The procs have to be in place before the first wgpu:: call.
+        DawnProcTable procs = dawn::native::GetProcs();
+        dawnProcSetProcs(&procs);
+
+        wgpu::Adapter adapter(backendAdapter.Get());
+        wgpu::AdapterProperties properties;
+        adapter.GetProperties(&properties);
+        adapterName = std::string(properties.name) + " " + properties.driverDescription;
+
+        std::vector<wgpu::FeatureName> requiredFeatures;
+        timestampQuery = options.profiling && adapter.HasFeature(wgpu::FeatureName::TimestampQuery);
+        if (timestampQuery)
+        {
+            requiredFeatures.push_back(wgpu::FeatureName::TimestampQuery);
+        }
+        else if (options.profiling)
+        {
+            LOGI("Adapter does not support timestamp queries, GPU profiling is disabled\n");
+        }
+
+        subgroups = options.subgroups && adapter.HasFeature(wgpu::FeatureName::ChromiumExperimentalSubgroups);
+        if (subgroups)
+        {
+            requiredFeatures.push_back(wgpu::FeatureName::ChromiumExperimentalSubgroups);
+        }
+
+        // Timestamp queries and experimental subgroups are only exposed with allow_unsafe_apis.
+        const char *enabledToggles[] = {"allow_unsafe_apis"};
+        wgpu::DawnTogglesDescriptor togglesDescriptor;
+        togglesDescriptor.enabledToggles = enabledToggles;
+        togglesDescriptor.enabledToggleCount = 1;
+
+        wgpu::DeviceDescriptor deviceDescriptor;
+        deviceDescriptor.requiredFeatures = requiredFeatures.data();
+        deviceDescriptor.requiredFeatureCount = requiredFeatures.size();
+        if (!requiredFeatures.empty())
+        {
+            deviceDescriptor.nextInChain = &togglesDescriptor;
+        }
+
+        WGPUDevice device = backendAdapter.CreateDevice(&deviceDescriptor);
+        procs.deviceSetUncapturedErrorCallback(device, PrintDeviceError, nullptr);
+        return wgpu::Device::Acquire(device);
+    }
+
+    wgpu::Buffer CreateStorageBuffer(uint64_t size, wgpu::BufferUsage usage, const char *label)
+    {
+        wgpu::BufferDescriptor descriptor;
+        descriptor.size = size;
+        descriptor.usage = wgpu::BufferUsage::Storage | usage;
+        descriptor.label = label;
+        return device.CreateBuffer(&descriptor);
+    }
+
+    uint32_t PendingTuneCandidates()
+    {
+        return std::count_if(tuneCandidates.begin(), tuneCandidates.end(), [](const std::shared_ptr<const CachedPipeline> &candidate)
+                             { return !candidate->ready && !candidate->failed; });
+    }
+
+    // Auto-tune candidates still compiling don't hold frames back.
+    bool PipelinesReady()
+    {
+        return !cpuFallback && pipelineCache.PendingCount() == PendingTuneCandidates() && !pipelineCache.AnyFailed() && binningPipeline->ready;
+    }
+
+    // Delivers asynchronous pipeline creations from device.Tick(), once per
+    // frame until every pipeline is ready. A creation that failed is
+    // compiled again blocking, in case the async path was at fault; one
+    // that fails again keeps the frames on the CPU binner.
+    void TickPipelines()
+    {
+        if (cpuFallback || (PipelinesReady() && pipelineCache.AllReady()))
+        {
+            return;
+        }
+        device.Tick();
+        if (pipelineCache.RetryPending())
+        {
+            uint32_t recovered = pipelineCache.RetryFailed();
+            LOGE("Pipelines failed to compile asynchronously, %u recovered blocking%s\n", recovered,
+                 pipelineCache.AnyFailed() ? ", staying on the CPU binner" : "");
+        }
+    }
+
+    // Frames run on the CPU binner until the GPU pipelines have compiled.
+    bool UseCpuPath()
+    {
+        return !PipelinesReady();
+    }
+
+    uint32_t PathStride()
+    {
+        return compactPaths ? sizeof(uint32_t) : sizeof(PathInfo);
+    }
+
+    // The path_info binning and tiling read: the scene, or its survivors
+    // when culling.
+    wgpu::Buffer BinnedPathBuffer()
+    {
+        return cullPaths ? visiblePathBuffer : pathAreaBuffer;
+    }
+
+    // Grows the path and output buffers geometrically, so a scene that keeps
+    // growing reallocates O(log n) times. Switching to a smaller workgroup
+    // size only reallocates the outputs, which then hold more partitions.
+    void ReservePaths(uint32_t count)
+    {
+        bool growPaths = count > pathCapacity || pathCapacity == 0;
+        uint32_t numPartitions = NumPartitions(std::max(count, pathCapacity), variant.workgroupSize);
+        if (!growPaths && numPartitions <= partitionCapacity)
+        {
+            return;
+        }
+
+        if (growPaths)
+        {
+            pathCapacity = std::max(NumPartitions(count) * kWorkgroupSize, pathCapacity * 2);
+            pathAreaBuffer = CreateStorageBuffer(pathCapacity * PathStride(), wgpu::BufferUsage::CopyDst, "PathInfo");
+            if (cullPaths)
+            {
+                visiblePathBuffer = CreateStorageBuffer(pathCapacity * PathStride(), wgpu::BufferUsage::None, "VisiblePaths");
+                visibleIndexBuffer = CreateStorageBuffer(pathCapacity * sizeof(uint32_t), wgpu::BufferUsage::None, "VisibleIndices");
+            }
+        }
+
+        numPartitions = NumPartitions(pathCapacity, variant.workgroupSize);
+        if (numPartitions > partitionCapacity)
+        {
+            partitionCapacity = numPartitions;
+            outputBuffer = CreateStorageBuffer(numPartitions * kNumBins * sizeof(uint32_t), wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst, "BinHeader");
+            bitmapBuffer = CreateStorageBuffer(numPartitions * kBitmapWords * sizeof(uint32_t), wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst, "BinBitmap");
+            if (tiling)
+            {
+                binOffsetBuffer = CreateStorageBuffer(numPartitions * kNumBins * sizeof(uint32_t), wgpu::BufferUsage::None, "BinOffsets");
+            }
+            if (cullPaths)
+            {
+                // CullState: the partition counter and one status per partition.
+                cullStateBuffer = CreateStorageBuffer((1 + numPartitions) * sizeof(uint32_t), wgpu::BufferUsage::CopyDst, "CullState");
+            }
+        }
+        tilingBindGroup = nullptr;
+        binKeysBindGroup = nullptr;
+        cullBindGroup = nullptr;
+        bindGroup = dawn::utils::MakeBindGroup(device, bgl, {{0, BinnedPathBuffer()}, {1, outputBuffer}, {2, uniformBuffer}, {3, bitmapBuffer}});
+        incrementalBindGroup = nullptr;
+    }
+
+    // Sizes the tiling lists for at least the given number of entries, and
+    // the tile table for the current tile size.
+    void ReserveTiling(uint32_t binPaths, uint32_t tilePaths)
+    {
+        uint32_t tiles = kNumBins * variant.tileSize * variant.tileSize;
+        if (binPaths <= binPathCapacity && tilePaths <= tilePathCapacity && tiles <= tileCapacity)
+        {
+            return;
+        }
+
+        if (binPaths > binPathCapacity)
+        {
+            binPathCapacity = std::bit_ceil(binPaths);
+            binPathBuffer = CreateStorageBuffer(binPathCapacity * sizeof(uint32_t), wgpu::BufferUsage::None, "BinPaths");
+        }
+        if (tilePaths > tilePathCapacity)
+        {
+            tilePathCapacity = std::bit_ceil(tilePaths);
+            tilePathBuffer = CreateStorageBuffer(tilePathCapacity * sizeof(uint32_t), wgpu::BufferUsage::CopySrc, "TilePaths");
+        }
+        if (tiles > tileCapacity)
+        {
+            tileCapacity = tiles;
+            tileBuffer = CreateStorageBuffer(tileCapacity * 2 * sizeof(uint32_t), wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst, "Tiles");
+        }
+        tilingBindGroup = nullptr;
+    }
+
+    // Grows the lists after a frame that needed more entries than they hold;
+    // that frame's lists were truncated.
+    void GrowTiling(const TilingCounters &counters)
+    {
+        if (counters.binPaths > binPathCapacity || counters.tilePaths > tilePathCapacity)
+        {
+            LOGI("Tiling lists overflowed (%u bin paths, %u tile paths), growing\n", counters.binPaths, counters.tilePaths);
+            ReserveTiling(counters.binPaths, counters.tilePaths);
+        }
+    }
+
+    // Same for the sort keys of the bin lists.
+    void GrowBinKeys(uint32_t count)
+    {
+        if (count > binSort.Capacity())
+        {
+            LOGI("Bin keys overflowed (%u keys), growing\n", count);
+            binSort.Reserve(count);
+            binKeysBindGroup = nullptr;
+        }
+    }
+
+    PathInfo *BeginPathUpload(uint32_t count)
+    {
+        uniforms.path_count = count;
+        callerScene = true;
+        // The CPU binner reads the host copy, and compact paths are encoded
+        // from it; it is staged from there in EndPathUpload().
+        if (UseCpuPath() || compactPaths)
+        {
+            hostPaths.resize(count);
+            return hostPaths.data();
+        }
+
+        hostPaths.clear();
+        ReservePaths(count);
+        if (count == 0)
+        {
+            return nullptr;
+        }
+        return static_cast<PathInfo *>(uploadRing.Acquire(count * sizeof(PathInfo)));
+    }
+
+    void EndPathUpload()
+    {
+        if (cpuFallback)
+        {
+            return;
+        }
+
+        uint32_t count = uniforms.path_count;
+        binHeaderValid = false;
+        if (compactPaths)
+        {
+            ReservePaths(count);
+            BinGrid grid = GetBinGrid(uniforms.width, uniforms.height, variant.tileSize);
+            // Like BeginPathUpload(), an empty scene acquires no slot: nothing
+            // would record its copy, and it would never return to the ring.
+            uint32_t *staging = count > 0 ? static_cast<uint32_t *>(uploadRing.Acquire(count * sizeof(uint32_t))) : nullptr;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                staging[i] = EncodeCompactPath(hostPaths[i], grid.widthInBins * variant.tileSize, grid.heightInBins * variant.tileSize);
+            }
+        }
+        else if (!hostPaths.empty())
+        {
+            ReservePaths(count);
+            memcpy(uploadRing.Acquire(count * sizeof(PathInfo)), hostPaths.data(), count * sizeof(PathInfo));
+        }
+
+        device.GetQueue().WriteBuffer(uniformBuffer, 0, &uniforms, sizeof(ComputeUniforms));
+        if (count == 0)
+        {
+            return;
+        }
+
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        uploadRing.RecordCopy(encoder, pathAreaBuffer, 0, count * PathStride());
+        wgpu::CommandBuffer commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+        uploadRing.Submitted();
+    }
+
+    void SetPaths(const PathInfo *paths, uint32_t count)
+    {
+        PathInfo *staging = BeginPathUpload(count);
+        if (count > 0)
+        {
+            memcpy(staging, paths, count * sizeof(PathInfo));
+        }
+        EndPathUpload();
+    }
+
+    void SetPathGeometry(const PathPoint *points, const PathGeometry *paths, uint32_t count)
+    {
+        PathInfo *staging = BeginPathUpload(count);
+        EncodePaths(*encoderPool, points, paths, count, uniforms.width, uniforms.height, variant.tileSize, staging);
+        EndPathUpload();
+    }
+
+    void ReserveEdits(uint32_t count)
+    {
+        if (count <= editCapacity)
+        {
+            return;
+        }
+
+        editCapacity = std::max({count, editCapacity * 2, kWorkgroupSize});
+        editBuffer = CreateStorageBuffer(editCapacity * sizeof(PathEdit), wgpu::BufferUsage::CopyDst, "PathEdits");
+        // There are at most as many edited partitions as edits.
+        partitionEditBuffer = CreateStorageBuffer(editCapacity * sizeof(PartitionEdits), wgpu::BufferUsage::CopyDst, "PartitionEdits");
+        incrementalBindGroup = nullptr;
+    }
+
+    void UpdatePaths(const PathEdit *edits, uint32_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        // The CPU binner recounts every frame anyway, so only the scene changes.
+        if (UseCpuPath())
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                hostPaths[edits[i].index] = edits[i].newInfo;
+            }
+            EndPathUpload();
+            return;
+        }
+
+        // The GPU encodes the edited paths itself, see compactPathStore.
+        if (compactPaths)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                hostPaths[edits[i].index] = edits[i].newInfo;
+            }
+        }
+
+        // Group the edits by partition, one workgroup each.
+        sortedEdits.assign(edits, edits + count);
+        std::sort(sortedEdits.begin(), sortedEdits.end(), [](const PathEdit &a, const PathEdit &b)
+                  { return a.index < b.index; });
+
+        ReserveEdits(count);
+        if (!incrementalBindGroup)
+        {
+            incrementalBindGroup = dawn::utils::MakeBindGroup(device, incrementalBgl, {{0, pathAreaBuffer}, {1, outputBuffer}, {2, uniformBuffer}, {3, bitmapBuffer}, {4, editBuffer}, {5, partitionEditBuffer}});
+        }
+
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        memcpy(uploadRing.Acquire(count * sizeof(PathEdit)), sortedEdits.data(), count * sizeof(PathEdit));
+        uploadRing.RecordCopy(encoder, editBuffer, 0, count * sizeof(PathEdit));
+
+        PartitionEdits *partitions = static_cast<PartitionEdits *>(uploadRing.Acquire(count * sizeof(PartitionEdits)));
+        uint32_t numPartitions = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t partition = sortedEdits[i].index / variant.workgroupSize;
+            if (numPartitions == 0 || partitions[numPartitions - 1].partition != partition)
+            {
+                partitions[numPartitions++] = {partition, i, i, 0};
+            }
+            partitions[numPartitions - 1].end = i + 1;
+        }
+        uploadRing.RecordCopy(encoder, partitionEditBuffer, 0, numPartitions * sizeof(PartitionEdits));
+
+        wgpu::ComputePassDescriptor descriptor;
+        descriptor.timestampWrites = profiler.BeginPass("IncrementalBinning");
+        wgpu::ComputePassEncoder passEncoder = encoder.BeginComputePass(&descriptor);
+        passEncoder.SetPipeline(incrementalPipeline->pipeline);
+        passEncoder.SetBindGroup(0, incrementalBindGroup);
+        passEncoder.DispatchWorkgroups(numPartitions);
+        passEncoder.End();
+        // Resolved in this submit, as a profiler frame of its own, so edits
+        // between frames don't pile passes onto the next one.
+        profiler.ResolveFrame(encoder);
+
+        wgpu::CommandBuffer commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+        profiler.EndFrame();
+        uploadRing.Submitted();
+    }
+
+    // coarse_main keeps two words per tile of a bin, TILE_SIZE * TILE_SIZE
+    // tiles, in workgroup memory, which from 64 on no longer fits the 16 KB
+    // minimum limit.
+    constexpr uint32_t kMaxTilingTileSize = 32;
+
+    bool IsValidVariant(const BinningVariant &candidate)
+    {
+        return candidate.workgroupSize >= 32 && candidate.workgroupSize <= kWorkgroupSize && candidate.workgroupSize % 32 == 0 &&
+               candidate.tileSize != 0 && (candidate.tileSize & (candidate.tileSize - 1)) == 0 &&
+               candidate.tileSize <= (tiling ? kMaxTilingTileSize : 256);
+    }
+
+    std::vector<wgpu::ConstantEntry> VariantConstants(const BinningVariant &v)
+    {
+        return {
+            {nullptr, "WG_SIZE", static_cast<double>(v.workgroupSize)},
+            {nullptr, "N_TILE", static_cast<double>(kNumBins)},
+            {nullptr, "TILE_SIZE", static_cast<double>(v.tileSize)},
+        };
+    }
+
+    // Snippets that bind path_info in the current path format.
+    std::string PathSource()
+    {
+        return compactPaths ? std::string(compactPathCodec) + compactPathSource : pathInfoSource;
+    }
+
+    std::string PathStore()
+    {
+        return compactPaths ? std::string(compactPathCodec) + compactPathStore : pathInfoStore;
+    }
+
+    // Fetches the pipelines of the current variant from the cache, compiling
+    // them if needed. Frames bin on the CPU until they are ready.
+    void CreateBinningPipelines(bool blocking)
+    {
+        std::vector<wgpu::ConstantEntry> constants = VariantConstants(variant);
+        std::string incrementalSource = std::string(binningCommon) + PathStore() + incrementalBinningShader;
+        if (blocking)
+        {
+            pipelineCache.Get(bgl, binningSource, "main", constants, binningLabel);
+            pipelineCache.Get(incrementalBgl, incrementalSource, "main", constants, "IncrementalBinning");
+        }
+        binningPipeline = pipelineCache.GetAsync(bgl, binningSource, "main", constants, binningLabel);
+        incrementalPipeline = pipelineCache.GetAsync(incrementalBgl, incrementalSource, "main", constants, "IncrementalBinning");
+
+        if (cullPaths)
+        {
+            std::string cullSource = std::string(binningCommon) + PathSource() + cullShader;
+            if (blocking)
+            {
+                pipelineCache.Get(cullBgl, cullSource, "main", constants, "Cull");
+            }
+            cullPipeline = pipelineCache.GetAsync(cullBgl, cullSource, "main", constants, "Cull");
+        }
+
+        if (sortedBinLists)
+        {
+            std::string binKeysSource = std::string(binningCommon) + PathSource() + binKeysShader;
+            if (blocking)
+            {
+                pipelineCache.Get(binKeysBgl, binKeysSource, "main", constants, "BinKeys");
+            }
+            binKeysPipeline = pipelineCache.GetAsync(binKeysBgl, binKeysSource, "main", constants, "BinKeys");
+        }
+
+        if (!tiling)
+        {
+            return;
+        }
+        std::string tilingSource = std::string(binningCommon) + tilingBindings + PathSource() + (cullPaths ? culledSceneIndexSource : sceneIndexSource) +
+                                   partitionLinesShader + tilingShader;
+        if (blocking)
+        {
+            pipelineCache.Get(tilingBgl, tilingSource, "bin_offsets_main", constants, "BinOffsets");
+            pipelineCache.Get(tilingBgl, tilingSource, "scatter_main", constants, "Scatter");
+            pipelineCache.Get(tilingBgl, tilingSource, "coarse_main", constants, "Coarse");
+        }
+        binOffsetsPipeline = pipelineCache.GetAsync(tilingBgl, tilingSource, "bin_offsets_main", constants, "BinOffsets");
+        scatterPipeline = pipelineCache.GetAsync(tilingBgl, tilingSource, "scatter_main", constants, "Scatter");
+        coarsePipeline = pipelineCache.GetAsync(tilingBgl, tilingSource, "coarse_main", constants, "Coarse");
+    }
+
+    // Sets binningSource for `mode`; the pipelines follow with the next
+    // CreateBinningPipelines().
+    void SelectBinningKernel(BinningMode mode)
+    {
+        binningMode = mode == BinningMode::Subgroup && !subgroups ? BinningMode::Atomic : mode;
+        switch (binningMode)
+        {
+        case BinningMode::Bitmap:
+            binningSource = std::string(binningCommon) + binningBindings + PathSource() + partitionLinesShader + bitmapBinningShader;
+            binningLabel = "BitmapBinning";
+            break;
+        case BinningMode::Subgroup:
+            binningSource = std::string(subgroupsEnable) + binningCommon + binningBindings + PathSource() + subgroupBinningShader;
+            binningLabel = "SubgroupBinning";
+            break;
+        case BinningMode::Atomic:
+            binningSource = std::string(binningCommon) + binningBindings + PathSource() + atomicBinningShader;
+            binningLabel = "AtomicBinning";
+            break;
+        }
+    }
+
+    // Auto-tune winners, one "<adapter> <mode> tile <n>\t<workgroup size>"
+    // line each, with " subgroup" appended when the subgroup kernel won. The
+    // atomic and subgroup kernels share the AtomicBinning entry.
+    std::string TunedVariantKey()
+    {
+        const char *mode = binningMode == BinningMode::Bitmap ? "BitmapBinning" : "AtomicBinning";
+        return adapterName + " " + mode + " tile " + std::to_string(variant.tileSize);
+    }
+
+    bool LoadTunedVariant(BinningVariant *tuned, BinningMode *mode)
+    {
+        std::ifstream file(tunedVariantsPath);
+        std::string line;
+        std::string key = TunedVariantKey();
+        while (std::getline(file, line))
+        {
+            size_t tab = line.rfind('\t');
+            if (tab != std::string::npos && line.compare(0, tab, key) == 0 && tab == key.size())
+            {
+                // The file may be truncated or hand edited.
+                const char *value = line.c_str() + tab + 1;
+                char *end = nullptr;
+                errno = 0;
+                unsigned long workgroupSize = strtoul(value, &end, 10);
+                bool subgroupKernel = strcmp(end, " subgroup") == 0;
+                if (end == value || (*end != '\0' && !subgroupKernel) || errno != 0 || workgroupSize > kWorkgroupSize)
+                {
+                    LOGE("Ignoring malformed tuned variant \"%s\"\n", line.c_str());
+                    return false;
+                }
+                *tuned = {static_cast<uint32_t>(workgroupSize), variant.tileSize};
+                *mode = subgroupKernel ? BinningMode::Subgroup : binningMode == BinningMode::Bitmap ? BinningMode::Bitmap : BinningMode::Atomic;
+                return IsValidVariant(*tuned);
+            }
+        }
+        return false;
+    }
+
+    void StoreTunedVariant(const BinningVariant &tuned)
+    {
+        if (tunedVariantsPath.empty())
+        {
+            return;
+        }
+
+        std::vector<std::string> lines;
+        std::string key = TunedVariantKey();
+        {
+            std::ifstream file(tunedVariantsPath);
+            std::string line;
+            while (std::getline(file, line))
+            {
+                if (line.compare(0, key.size() + 1, key + "\t") != 0)
+                {
+                    lines.push_back(line);
+                }
+            }
+        }
+        lines.push_back(key + "\t" + std::to_string(tuned.workgroupSize) + (binningMode == BinningMode::Subgroup ? " subgroup" : ""));
+
+        std::ofstream file(tunedVariantsPath, std::ios::trunc);
+        for (const std::string &line : lines)
+        {
+            file << line << "\n";
+        }
+    }
+
+    void Init(uint32_t width, uint32_t height, const Options &options)
+    {
+        initStart = Clock::now();
+        timeToFirstFrameMs = -1;
+
+        CreateInstance(options);
+        device = AndroidCreateDevice(options);
+
+        uniforms.width = width;
+        uniforms.height = height;
+
+        // Tiling limits the tile size.
+        tiling = options.tiling;
+        variant = options.variant;
+        if (!IsValidVariant(variant))
+        {
+            LOGE("Unsupported binning variant (workgroup size %u, tile size %u), using the default\n", variant.workgroupSize, variant.tileSize);
+            variant = {};
+        }
+
+        uint32_t encoderThreads = options.encoderThreads != 0 ? options.encoderThreads : std::max(std::thread::hardware_concurrency(), 1u);
+        if (!encoderPool || encoderPool->ThreadCount() != encoderThreads)
+        {
+            encoderPool = std::make_unique<ThreadPool>(encoderThreads);
+        }
+
+        cpuFallback = device == nullptr;
+        if (cpuFallback)
+        {
+            LOGI("Binning on the CPU (%s)\n", CpuBinnerKernelName());
+            SetPaths(reinterpret_cast<const PathInfo *>(pathAreaData), sizeof(pathAreaData) / (2 * sizeof(uint32_t)));
+            return;
+        }
+
+        readbackPool.Init(device);
+        uploadRing.Init(device);
+        pathCapacity = 0;
+        partitionCapacity = 0;
+        editCapacity = 0;
+        binPathCapacity = 0;
+        tilePathCapacity = 0;
+        tileCapacity = 0;
+        sortedBinLists = options.sortedBinLists;
+        binKeysBindGroup = nullptr;
+        // Incremental frames patch bin_header by scene partition.
+        cullPaths = options.cullPaths && !options.incrementalBinning;
+        if (options.cullPaths && !cullPaths)
+        {
+            LOGI("Culling is not supported with incremental binning, binning every path\n");
+        }
+        cullBindGroup = nullptr;
+        incrementalBinning = options.incrementalBinning;
+        profiler.Init(device, &readbackPool, timestampQuery);
+        pipelineCache.Init(device, cachingPlatform ? &cachingPlatform->Cache() : nullptr);
+
+        wgpu::BufferDescriptor descriptor;
+        descriptor.size = sizeof(ComputeUniforms);
+        descriptor.usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst;
+        uniformBuffer = device.CreateBuffer(&descriptor);
+
+        bgl = dawn::utils::MakeBindGroupLayout(device, {
+                                                           {0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                           {1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                           {2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform},
+                                                           {3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                       });
+
+        compactPaths = options.compactPaths && CompactPathsFit(width, height, variant.tileSize);
+        if (options.compactPaths && !compactPaths)
+        {
+            LOGI("Bin grid too large for compact paths, using full PathInfo\n");
+        }
+
+        if (options.binningMode == BinningMode::Subgroup && !subgroups)
+        {
+            LOGI("Adapter has no subgroups, using the atomic kernel\n");
+        }
+        SelectBinningKernel(options.binningMode);
+
+        incrementalBgl = dawn::utils::MakeBindGroupLayout(device, {
+                                                                      {0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                      {1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                      {2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform},
+                                                                      {3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                      {4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                      {5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                  });
+
+        if (tiling)
+        {
+            // Binding 11 is the survivors' scene indices, see culledSceneIndexSource.
+            if (cullPaths)
+            {
+                tilingBgl = dawn::utils::MakeBindGroupLayout(device, {
+                                                                         {0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                         {1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                         {2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform},
+                                                                         {3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {6, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {7, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {8, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {9, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {10, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {11, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                     });
+            }
+            else
+            {
+                tilingBgl = dawn::utils::MakeBindGroupLayout(device, {
+                                                                         {0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                         {1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                         {2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform},
+                                                                         {3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {6, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {7, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {8, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {9, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                         {10, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                     });
+            }
+            binRangeBuffer = CreateStorageBuffer(kNumBins * 2 * sizeof(uint32_t), wgpu::BufferUsage::None, "BinRanges");
+            tilingCounterBuffer = CreateStorageBuffer(sizeof(TilingCounters), wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst, "TilingCounters");
+            tilingArgsBuffer = CreateStorageBuffer(sizeof(DispatchArgs), wgpu::BufferUsage::CopySrc, "TilingArgs");
+            occupiedBinBuffer = CreateStorageBuffer(kNumBins * sizeof(uint32_t), wgpu::BufferUsage::None, "OccupiedBins");
+
+            wgpu::BufferDescriptor indirectDescriptor;
+            indirectDescriptor.size = sizeof(DispatchArgs);
+            indirectDescriptor.usage = wgpu::BufferUsage::Indirect | wgpu::BufferUsage::CopyDst;
+            indirectDescriptor.label = "TilingIndirect";
+            tilingIndirectBuffer = device.CreateBuffer(&indirectDescriptor);
+        }
+
+        if (cullPaths)
+        {
+            cullBgl = dawn::utils::MakeBindGroupLayout(device, {
+                                                                  {0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                  {2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform},
+                                                                  {4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                  {5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                  {6, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                  {7, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                              });
+            cullArgsBuffer = CreateStorageBuffer(sizeof(DispatchArgs), wgpu::BufferUsage::CopySrc, "CullArgs");
+
+            wgpu::BufferDescriptor indirectDescriptor;
+            indirectDescriptor.size = sizeof(DispatchArgs);
+            indirectDescriptor.usage = wgpu::BufferUsage::Indirect | wgpu::BufferUsage::CopyDst;
+            indirectDescriptor.label = "CullIndirect";
+            cullIndirectBuffer = device.CreateBuffer(&indirectDescriptor);
+        }
+
+        if (sortedBinLists)
+        {
+            binKeysBgl = dawn::utils::MakeBindGroupLayout(device, {
+                                                                      {0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                                      {2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform},
+                                                                      {4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                      {5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                                  });
+            binSort.Init(device, pipelineCache, &profiler, {kBinKeyBits, kBinKeyShift, kNumBins}, !options.asyncPipelines);
+            binSort.Reserve(1 << 16);
+        }
+
+        // A stored winner replaces the requested workgroup size before anything compiles.
+        tunedVariantsPath = options.cacheDirectory.empty() ? "" : options.cacheDirectory + "/binning_variants";
+        autoTunePending = false;
+        tuneCandidates.clear();
+        BinningVariant tuned;
+        BinningMode tunedMode;
+        if (options.autoTune && LoadTunedVariant(&tuned, &tunedMode))
+        {
+            variant = tuned;
+            SelectBinningKernel(tunedMode);
+            LOGI("Using tuned %s with workgroup size %u\n", binningLabel, tuned.workgroupSize);
+        }
+        else if (options.autoTune)
+        {
+            autoTunePending = true;
+        }
+
+        // Compiles in the background; Frame() uses the CPU binner until it is ready.
+        CreateBinningPipelines(!options.asyncPipelines);
+        if (tiling)
+        {
+            ReserveTiling(1 << 16, 1 << 16);
+        }
+
+        SetPaths(reinterpret_cast<const PathInfo *>(pathAreaData), sizeof(pathAreaData) / (2 * sizeof(uint32_t)));
+        callerScene = false;
+    }
+
+    void LogBinTotals(const uint32_t *binHeader, uint32_t numPartitions)
+    {
+        // Sum the per-partition counts of the first few bins.
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            uint32_t total = 0;
+            for (uint32_t partition = 0; partition < numPartitions; partition++)
+            {
+                total += binHeader[partition * kNumBins + i];
+            }
+            LOGI("%d ", total);
+        }
+        LOGI("\nDone\n");
+    }
+
+    double MillisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void MarkFrameComplete(bool onCpu)
+    {
+        if (timeToFirstFrameMs < 0)
+        {
+            timeToFirstFrameMs = MillisecondsSince(initStart);
+            LOGI("First frame after %.2f ms (%s)\n", timeToFirstFrameMs, onCpu ? "cpu" : "gpu");
+            if (!cpuFallback)
+            {
+                pipelineCache.LogStats();
+            }
+        }
+    }
+
+    double TimeToFirstFrameMs()
+    {
+        return timeToFirstFrameMs;
+    }
+
+    // One compute pass of a frame, timed separately by the profiler. Stages
+    // without a host workgroup count take theirs from the DispatchArgs an
+    // earlier stage wrote to argsBuffer. They are copied into indirectBuffer,
+    // which cannot be bound for writing in the same dispatch that reads it.
+    struct Stage
+    {
+        const char *name;
+        const CachedPipeline *pipeline;
+        uint32_t workgroups;
+        wgpu::Buffer argsBuffer;
+        wgpu::Buffer indirectBuffer;
+    };
+
+    void EncodeStage(wgpu::CommandEncoder &encoder, const Stage &stage, const wgpu::BindGroup &stageBindGroup)
+    {
+        if (stage.workgroups == 0)
+        {
+            encoder.CopyBufferToBuffer(stage.argsBuffer, 0, stage.indirectBuffer, 0, sizeof(DispatchArgs));
+        }
+
+        wgpu::ComputePassDescriptor descriptor;
+        descriptor.timestampWrites = profiler.BeginPass(stage.name);
+        wgpu::ComputePassEncoder passEncoder = encoder.BeginComputePass(&descriptor);
+        passEncoder.SetPipeline(stage.pipeline->pipeline);
+        passEncoder.SetBindGroup(0, stageBindGroup);
+        if (stage.workgroups == 0)
+        {
+            passEncoder.DispatchWorkgroupsIndirect(stage.indirectBuffer, 0);
+        }
+        else
+        {
+            passEncoder.DispatchWorkgroups(stage.workgroups);
+        }
+        passEncoder.End();
+    }
+
+    // A stage with one workgroup per partition of the binned paths, which
+    // the cull pass counts on the GPU.
+    Stage BinnedStage(const char *name, const CachedPipeline *pipeline, uint32_t numPartitions)
+    {
+        if (cullPaths)
+        {
+            return {name, pipeline, 0, cullArgsBuffer, cullIndirectBuffer};
+        }
+        return {name, pipeline, numPartitions};
+    }
+
+    void EncodeBinning(wgpu::CommandEncoder &encoder, uint32_t numPartitions)
+    {
+        if (incrementalBinning && binHeaderValid)
+        {
+            return;
+        }
+        binHeaderValid = true;
+
+        if (!cullPaths)
+        {
+            EncodeStage(encoder, {"Binning", binningPipeline.get(), numPartitions}, bindGroup);
+            return;
+        }
+
+        if (!cullBindGroup)
+        {
+            cullBindGroup = dawn::utils::MakeBindGroup(device, cullBgl, {
+                                                                            {0, pathAreaBuffer},
+                                                                            {2, uniformBuffer},
+                                                                            {4, visiblePathBuffer},
+                                                                            {5, visibleIndexBuffer},
+                                                                            {6, cullStateBuffer},
+                                                                            {7, cullArgsBuffer},
+                                                                        });
+        }
+        encoder.ClearBuffer(cullStateBuffer);
+        // Binning only covers the partitions of the survivors; the rest of
+        // the frame's bin counts must read as empty.
+        encoder.ClearBuffer(outputBuffer, 0, numPartitions * kNumBins * sizeof(uint32_t));
+        encoder.ClearBuffer(bitmapBuffer, 0, numPartitions * kBitmapWords * sizeof(uint32_t));
+        EncodeStage(encoder, {"Cull", cullPipeline.get(), numPartitions}, cullBindGroup);
+        EncodeStage(encoder, BinnedStage("Binning", binningPipeline.get(), numPartitions), bindGroup);
+    }
+
+    // Chains the tiling stages after binning in the same encoder.
+    void EncodeTiling(wgpu::CommandEncoder &encoder, uint32_t numPartitions)
+    {
+        if (!tiling)
+        {
+            return;
+        }
+
+        if (!tilingBindGroup && cullPaths)
+        {
+            tilingBindGroup = dawn::utils::MakeBindGroup(device, tilingBgl, {
+                                                                                {0, BinnedPathBuffer()},
+                                                                                {1, outputBuffer},
+                                                                                {2, uniformBuffer},
+                                                                                {3, binOffsetBuffer},
+                                                                                {4, binRangeBuffer},
+                                                                                {5, binPathBuffer},
+                                                                                {6, tileBuffer},
+                                                                                {7, tilePathBuffer},
+                                                                                {8, tilingCounterBuffer},
+                                                                                {9, tilingArgsBuffer},
+                                                                                {10, occupiedBinBuffer},
+                                                                                {11, visibleIndexBuffer},
+                                                                            });
+        }
+        else if (!tilingBindGroup)
+        {
+            tilingBindGroup = dawn::utils::MakeBindGroup(device, tilingBgl, {
+                                                                                {0, BinnedPathBuffer()},
+                                                                                {1, outputBuffer},
+                                                                                {2, uniformBuffer},
+                                                                                {3, binOffsetBuffer},
+                                                                                {4, binRangeBuffer},
+                                                                                {5, binPathBuffer},
+                                                                                {6, tileBuffer},
+                                                                                {7, tilePathBuffer},
+                                                                                {8, tilingCounterBuffer},
+                                                                                {9, tilingArgsBuffer},
+                                                                                {10, occupiedBinBuffer},
+                                                                            });
+        }
+
+        const Stage stages[] = {
+            {"BinOffsets", binOffsetsPipeline.get(), 1},
+            BinnedStage("Scatter", scatterPipeline.get(), numPartitions),
+            {"Coarse", coarsePipeline.get(), 0, tilingArgsBuffer, tilingIndirectBuffer},
+        };
+
+        encoder.ClearBuffer(tilingCounterBuffer);
+        encoder.ClearBuffer(tileBuffer);
+        for (const Stage &stage : stages)
+        {
+            EncodeStage(encoder, stage, tilingBindGroup);
+        }
+    }
+
+    // Sorts the bin keys of every path after binning, in the same encoder.
+    void EncodeBinLists(wgpu::CommandEncoder &encoder, uint32_t numPartitions)
+    {
+        if (!sortedBinLists)
+        {
+            return;
+        }
+
+        encoder.ClearBuffer(binSort.KeyCount());
+        // Path indices above the path bits would land in the wrong bin.
+        if (uniforms.path_count > 1u << kBinKeyShift)
+        {
+            return;
+        }
+
+        if (!binKeysBindGroup)
+        {
+            binKeysBindGroup = dawn::utils::MakeBindGroup(device, binKeysBgl, {
+                                                                                  {0, pathAreaBuffer},
+                                                                                  {2, uniformBuffer},
+                                                                                  {4, binSort.Keys()},
+                                                                                  {5, binSort.KeyCount()},
+                                                                              });
+        }
+
+        wgpu::ComputePassDescriptor descriptor;
+        descriptor.timestampWrites = profiler.BeginPass("BinKeys");
+        wgpu::ComputePassEncoder passEncoder = encoder.BeginComputePass(&descriptor);
+        passEncoder.SetPipeline(binKeysPipeline->pipeline);
+        passEncoder.SetBindGroup(0, binKeysBindGroup);
+        passEncoder.DispatchWorkgroups(numPartitions);
+        passEncoder.End();
+
+        binSort.Encode(encoder);
+    }
+
+    // Auto-tune times every workgroup size at the configured tile size. With
+    // subgroups the atomic kernel competes against the subgroup one.
+    constexpr uint32_t kTuneWorkgroupSizes[] = {64, 128, 256};
+
+    std::vector<BinningMode> TuneKernels()
+    {
+        if (binningMode != BinningMode::Bitmap && subgroups)
+        {
+            return {BinningMode::Atomic, BinningMode::Subgroup};
+        }
+        return {binningMode};
+    }
+
+    // Starts compiling the pipelines of every variant AutoTuneBinning()
+    // times, without switching frames to them.
+    void RequestTuneCandidates()
+    {
+        BinningVariant current = variant;
+        BinningMode currentMode = binningMode;
+        for (BinningMode kernel : TuneKernels())
+        {
+            SelectBinningKernel(kernel);
+            for (uint32_t workgroupSize : kTuneWorkgroupSizes)
+            {
+                variant = {workgroupSize, current.tileSize};
+                CreateBinningPipelines(false);
+                for (const std::shared_ptr<const CachedPipeline> &pipeline :
+                     {binningPipeline, incrementalPipeline, cullPipeline, binKeysPipeline, binOffsetsPipeline, scatterPipeline, coarsePipeline})
+                {
+                    if (pipeline && std::find(tuneCandidates.begin(), tuneCandidates.end(), pipeline) == tuneCandidates.end())
+                    {
+                        tuneCandidates.push_back(pipeline);
+                    }
+                }
+            }
+        }
+        SelectBinningKernel(currentMode);
+        variant = current;
+        CreateBinningPipelines(false);
+    }
+
+    // Runs the first-launch auto-tune once the caller has set a scene. The
+    // candidates compile in the background from then on, and only the frame
+    // that finds them all ready pays for timing them.
+    void MaybeAutoTune()
+    {
+        if (!autoTunePending || !callerScene || UseCpuPath())
+        {
+            return;
+        }
+        if (tuneCandidates.empty())
+        {
+            RequestTuneCandidates();
+        }
+        if (PendingTuneCandidates() == 0)
+        {
+            AutoTuneBinning();
+        }
+    }
+
+    void Frame()
+    {
+        frameArena.Reset();
+        TickPipelines();
+        MaybeAutoTune();
+        uint32_t numPartitions = NumPartitions(uniforms.path_count, variant.workgroupSize);
+
+        if (UseCpuPath())
+        {
+            uint32_t *binHeader = frameArena.Allocate<uint32_t>(numPartitions * kNumBins);
+            uint32_t *binBitmap = frameArena.Allocate<uint32_t>(numPartitions * kBitmapWords);
+            CpuBin(hostPaths.data(), uniforms.path_count, uniforms.width, uniforms.height, binHeader, binBitmap, variant);
+            MarkFrameComplete(true);
+            LogBinTotals(binHeader, numPartitions);
+            return;
+        }
+
+        uint32_t headerSize = numPartitions * kNumBins * sizeof(uint32_t);
+        uint32_t bitmapSize = numPartitions * kBitmapWords * sizeof(uint32_t);
+
+        // The readback copies ride along in the frame's own submit.
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        EncodeBinning(encoder, numPartitions);
+        EncodeTiling(encoder, numPartitions);
+        EncodeBinLists(encoder, numPartitions);
+        MapReadRequest requests[] = {
+            {readbackPool.RecordCopy(encoder, outputBuffer, headerSize), headerSize, &readbackPool},
+            {readbackPool.RecordCopy(encoder, bitmapBuffer, bitmapSize), bitmapSize, &readbackPool},
+            {},
+            {},
+        };
+        uint32_t numRequests = 2;
+        int tilingRequest = -1;
+        int binKeysRequest = -1;
+        if (tiling)
+        {
+            tilingRequest = numRequests;
+            requests[numRequests++] = {readbackPool.RecordCopy(encoder, tilingCounterBuffer, sizeof(TilingCounters)), sizeof(TilingCounters), &readbackPool};
+        }
+        if (sortedBinLists)
+        {
+            binKeysRequest = numRequests;
+            requests[numRequests++] = {readbackPool.RecordCopy(encoder, binSort.KeyCount(), sizeof(uint32_t)), sizeof(uint32_t), &readbackPool};
+        }
+        profiler.ResolveFrame(encoder);
+
+        wgpu::CommandBuffer commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+        profiler.EndFrame();
+
+        // Mapping waits for the dispatch and the copies to finish. The views
+        // read straight out of the staging buffers and return them to the pool.
+        Clock::time_point waitStart = Clock::now();
+        FrameVector<MappedView<uint32_t>> views = MapReadBuffers<uint32_t>(device, requests, numRequests, &frameArena);
+        frameStats.blockingFrames++;
+        frameStats.blockingWaitMs += MillisecondsSince(waitStart);
+
+        if (!views[0] || !views[1])
+        {
+            return;
+        }
+        if (tilingRequest >= 0 && views[tilingRequest])
+        {
+            TilingCounters counters = {views[tilingRequest][0], views[tilingRequest][1]};
+            LOGI("%u bin list entries, %u tile list entries\n", counters.binPaths, counters.tilePaths);
+            GrowTiling(counters);
+        }
+        if (binKeysRequest >= 0 && views[binKeysRequest])
+        {
+            LOGI("%u sorted bin keys\n", views[binKeysRequest][0]);
+            GrowBinKeys(views[binKeysRequest][0]);
+        }
+
+        uint32_t occupiedBins = 0;
+        for (uint32_t word : views[1])
+        {
+            occupiedBins += __builtin_popcount(word);
+        }
+        MarkFrameComplete(false);
+        LOGI("%u occupied bins in %u partitions\n", occupiedBins, numPartitions);
+        LogBinTotals(views[0].data(), numPartitions);
+        for (const PassTiming &timing : profiler.GetTimings())
+        {
+            LOGI("%s: min %.3f avg %.3f p99 %.3f ms over %u frames\n", timing.name.c_str(), timing.minMs, timing.avgMs, timing.p99Ms, timing.samples);
+        }
+    }
+
+    void OnFrameReadback(WGPUBufferMapAsyncStatus status, void *userdata)
+    {
+        FrameSlot &slot = *static_cast<FrameSlot *>(userdata);
+        slot.inFlight = false;
+        wgpu::Buffer readbackBuffer = std::move(slot.readbackBuffer);
+
+        if (status != WGPUBufferMapAsyncStatus_Success)
+        {
+            LOGE("Failed to read back frame %llu, with status: %d\n", static_cast<unsigned long long>(slot.frameIndex), static_cast<int>(status));
+            readbackPool.Release(std::move(readbackBuffer));
+            return;
+        }
+
+        frameStats.pipelinedFrames++;
+        frameStats.gpuLatencyMs += MillisecondsSince(slot.submitTime);
+        frameStats.avoidedWaitMs += std::chrono::duration<double, std::milli>(slot.pendingAt - slot.submitTime).count();
+
+        MarkFrameComplete(false);
+        FrameResult result;
+        result.frameIndex = slot.frameIndex;
+        result.numPartitions = slot.numPartitions;
+        result.binHeader = static_cast<const uint32_t *>(readbackBuffer.GetConstMappedRange(0, slot.readbackSize));
+        result.tiling = {};
+        if (tiling)
+        {
+            // The counters follow the bin counts.
+            const uint32_t *counters = result.binHeader + slot.numPartitions * kNumBins;
+            result.tiling = {counters[0], counters[1]};
+            GrowTiling(result.tiling);
+        }
+        result.binKeys = 0;
+        if (sortedBinLists)
+        {
+            // The key count comes last.
+            result.binKeys = result.binHeader[slot.readbackSize / sizeof(uint32_t) - 1];
+            GrowBinKeys(result.binKeys);
+        }
+        if (slot.callback)
+        {
+            slot.callback(result);
+        }
+        readbackBuffer.Unmap();
+        readbackPool.Release(std::move(readbackBuffer));
+    }
+
+    // Delivers completed frames, and marks the rest as still busy now.
+    void TickFrames()
+    {
+        device.Tick();
+        Clock::time_point now = Clock::now();
+        for (FrameSlot &slot : frameSlots)
+        {
+            if (slot.inFlight)
+            {
+                slot.pendingAt = now;
+            }
+        }
+    }
+
+    // Delivers the queued CPU frames, which are always older than the ones
+    // still on the GPU.
+    void DeliverCpuFrames()
+    {
+        while (!cpuFrames.empty())
+        {
+            CpuFrame frame = std::move(cpuFrames.front());
+            cpuFrames.pop_front();
+            if (frame.callback)
+            {
+                frame.callback({frame.frameIndex, frame.binHeader.data(), frame.numPartitions, {}, 0});
+            }
+            spareCpuHeaders.push_back(std::move(frame.binHeader));
+        }
+    }
+
+    void SubmitFrame(FrameCallback callback)
+    {
+        frameArena.Reset();
+        TickPipelines();
+        MaybeAutoTune();
+        uint32_t numPartitions = NumPartitions(uniforms.path_count, variant.workgroupSize);
+        uint64_t headerSize = numPartitions * kNumBins * sizeof(uint32_t);
+        uint64_t readbackSize = headerSize + (tiling ? sizeof(TilingCounters) : 0) + (sortedBinLists ? sizeof(uint32_t) : 0);
+
+        if (UseCpuPath())
+        {
+            // Like a full set of slots, a full queue delivers before binning more.
+            if (cpuFrames.size() == kMaxFramesInFlight)
+            {
+                DeliverCpuFrames();
+            }
+            CpuFrame frame;
+            if (!spareCpuHeaders.empty())
+            {
+                frame.binHeader = std::move(spareCpuHeaders.back());
+                spareCpuHeaders.pop_back();
+            }
+            frame.binHeader.resize(numPartitions * kNumBins);
+            uint32_t *binBitmap = frameArena.Allocate<uint32_t>(numPartitions * kBitmapWords);
+            CpuBin(hostPaths.data(), uniforms.path_count, uniforms.width, uniforms.height, frame.binHeader.data(), binBitmap, variant);
+            MarkFrameComplete(true);
+            frame.frameIndex = frameCounter++;
+            frame.numPartitions = numPartitions;
+            frame.callback = std::move(callback);
+            cpuFrames.push_back(std::move(frame));
+            return;
+        }
+
+        // Only wait when every slot still has a frame on the GPU.
+        FrameSlot &slot = frameSlots[nextFrameSlot];
+        if (slot.inFlight)
+        {
+            DeliverCpuFrames();
+            Clock::time_point waitStart = Clock::now();
+            while (slot.inFlight)
+            {
+                TickFrames();
+                std::this_thread::sleep_for(std::chrono::microseconds{50});
+            }
+            frameStats.pipelinedWaitMs += MillisecondsSince(waitStart);
+        }
+        nextFrameSlot = (nextFrameSlot + 1) % kMaxFramesInFlight;
+
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        EncodeBinning(encoder, numPartitions);
+        EncodeTiling(encoder, numPartitions);
+        EncodeBinLists(encoder, numPartitions);
+        slot.readbackBuffer = readbackPool.Acquire(readbackSize);
+        encoder.CopyBufferToBuffer(outputBuffer, 0, slot.readbackBuffer, 0, headerSize);
+        if (tiling)
+        {
+            encoder.CopyBufferToBuffer(tilingCounterBuffer, 0, slot.readbackBuffer, headerSize, sizeof(TilingCounters));
+        }
+        if (sortedBinLists)
+        {
+            encoder.CopyBufferToBuffer(binSort.KeyCount(), 0, slot.readbackBuffer, readbackSize - sizeof(uint32_t), sizeof(uint32_t));
+        }
+        profiler.ResolveFrame(encoder);
+        wgpu::CommandBuffer commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+        profiler.EndFrame();
+
+        slot.numPartitions = numPartitions;
+        slot.readbackSize = readbackSize;
+        slot.frameIndex = frameCounter++;
+        slot.callback = std::move(callback);
+        slot.submitTime = Clock::now();
+        slot.pendingAt = slot.submitTime;
+        slot.inFlight = true;
+        // The map resolves once the copy above has executed.
+        slot.readbackBuffer.MapAsync(wgpu::MapMode::Read, 0, readbackSize, OnFrameReadback, &slot);
+    }
+
+    void WaitForIdle()
+    {
+        if (cpuFallback)
+        {
+            return;
+        }
+
+        bool done = false;
+        device.GetQueue().OnSubmittedWorkDone(
+            [](WGPUQueueWorkDoneStatus status, void *userdata) -> void
+            { *(static_cast<bool *>(userdata)) = true; },
+            &done);
+
+        while (!done)
+        {
+            device.Tick();
+            std::this_thread::sleep_for(std::chrono::microseconds{50});
+        }
+    }
+
+    void DispatchBinning()
+    {
+        if (UseCpuPath())
+        {
+            return;
+        }
+
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        EncodeBinning(encoder, NumPartitions(uniforms.path_count, variant.workgroupSize));
+        profiler.ResolveFrame(encoder);
+        wgpu::CommandBuffer commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+        profiler.EndFrame();
+    }
+
+    bool SetBinningVariant(const BinningVariant &newVariant)
+    {
+        if (!IsValidVariant(newVariant))
+        {
+            LOGE("Unsupported binning variant (workgroup size %u, tile size %u)\n", newVariant.workgroupSize, newVariant.tileSize);
+            return false;
+        }
+        if (compactPaths && !CompactPathsFit(uniforms.width, uniforms.height, newVariant.tileSize))
+        {
+            LOGE("Tile size %u does not fit compact paths\n", newVariant.tileSize);
+            return false;
+        }
+
+        bool reencode = compactPaths && newVariant.tileSize != variant.tileSize;
+        variant = newVariant;
+        binHeaderValid = false;
+        if (cpuFallback)
+        {
+            return true;
+        }
+
+        // Blocking, so frames never fall back to the CPU binner, which needs
+        // a host copy of the scene; previously used variants are cache hits.
+        CreateBinningPipelines(true);
+        ReservePaths(uniforms.path_count);
+        if (reencode)
+        {
+            EndPathUpload();
+        }
+        if (tiling)
+        {
+            ReserveTiling(binPathCapacity, tilePathCapacity);
+        }
+        return true;
+    }
+
+    BinningVariant GetBinningVariant()
+    {
+        return variant;
+    }
+
+    BinningVariant AutoTuneBinning()
+    {
+        if (UseCpuPath())
+        {
+            return variant;
+        }
+
+        // Wall clock around a full queue drain per dispatch, which works
+        // without timestamp queries.
+        const uint32_t kIterations = 10;
+        autoTunePending = false;
+        tuneCandidates.clear();
+        BinningVariant best = variant;
+        BinningMode bestMode = binningMode;
+        double bestMs = 0;
+        for (BinningMode kernel : TuneKernels())
+        {
+            SelectBinningKernel(kernel);
+            for (uint32_t workgroupSize : kTuneWorkgroupSizes)
+            {
+                SetBinningVariant({workgroupSize, best.tileSize});
+                std::vector<double> samples;
+                for (uint32_t i = 0; i <= kIterations; i++)
+                {
+                    Clock::time_point start = Clock::now();
+                    binHeaderValid = false;
+                    DispatchBinning();
+                    WaitForIdle();
+                    // The first dispatch warms up the pipeline.
+                    if (i > 0)
+                    {
+                        samples.push_back(MillisecondsSince(start));
+                    }
+                }
+
+                std::sort(samples.begin(), samples.end());
+                double medianMs = samples[samples.size() / 2];
+                LOGI("%s workgroup size %u: %.3f ms\n", binningLabel, workgroupSize, medianMs);
+                if (bestMs == 0 || medianMs < bestMs)
+                {
+                    bestMs = medianMs;
+                    best = variant;
+                    bestMode = binningMode;
+                }
+            }
+        }
+
+        SelectBinningKernel(bestMode);
+        SetBinningVariant(best);
+        StoreTunedVariant(best);
+        LOGI("Tuned %s with workgroup size %u for %s\n", binningLabel, best.workgroupSize, adapterName.c_str());
+        return best;
+    }
+
+    bool ReadBackBinHeader(std::vector<uint32_t> &binHeader)
+    {
+        if (UseCpuPath())
+        {
+            return false;
+        }
+
+        uint32_t headerSize = NumPartitions(uniforms.path_count, variant.workgroupSize) * kNumBins * sizeof(uint32_t);
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        wgpu::Buffer readbackBuffer = readbackPool.RecordCopy(encoder, outputBuffer, headerSize);
+        wgpu::CommandBuffer commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+
+        MappedView<uint32_t> view = MapReadBuffer<uint32_t>(device, readbackBuffer, headerSize, &readbackPool);
+        if (!view)
+        {
+            return false;
+        }
+        binHeader.assign(view.begin(), view.end());
+        return true;
+    }
+
+    // The sort pipelines compile on first use unless Options::sortedBinLists
+    // already created them.
+    bool EnsureBinSort()
+    {
+        if (cpuFallback)
+        {
+            return false;
+        }
+        if (!binSort.Initialized())
+        {
+            binSort.Init(device, pipelineCache, &profiler, {kBinKeyBits, kBinKeyShift, kNumBins}, true);
+        }
+        return true;
+    }
+
+    bool UploadSortKeys(const uint32_t *keys, uint32_t count)
+    {
+        if (!EnsureBinSort())
+        {
+            return false;
+        }
+        if (count > binSort.Capacity())
+        {
+            binSort.Reserve(count);
+            binKeysBindGroup = nullptr;
+        }
+        device.GetQueue().WriteBuffer(binSort.Keys(), 0, keys, uint64_t(count) * sizeof(uint32_t));
+        device.GetQueue().WriteBuffer(binSort.KeyCount(), 0, &count, sizeof(uint32_t));
+        return true;
+    }
+
+    void DispatchSort()
+    {
+        if (!EnsureBinSort())
+        {
+            return;
+        }
+
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        binSort.Encode(encoder);
+        profiler.ResolveFrame(encoder);
+        wgpu::CommandBuffer commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+        profiler.EndFrame();
+    }
+
+    bool ReadBackSortedKeys(std::vector<uint32_t> &keys, std::vector<uint32_t> &segmentOffsets)
+    {
+        if (!binSort.Initialized() || binSort.Capacity() == 0)
+        {
+            return false;
+        }
+
+        uint32_t offsetsSize = (kNumBins + 1) * sizeof(uint32_t);
+        uint32_t keysSize = binSort.Capacity() * sizeof(uint32_t);
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        MapReadRequest requests[] = {
+            {readbackPool.RecordCopy(encoder, binSort.KeyCount(), sizeof(uint32_t)), sizeof(uint32_t), &readbackPool},
+            {readbackPool.RecordCopy(encoder, binSort.SegmentOffsets(), offsetsSize), offsetsSize, &readbackPool},
+            {readbackPool.RecordCopy(encoder, binSort.SortedKeys(), keysSize), keysSize, &readbackPool},
+        };
+        wgpu::CommandBuffer commands = encoder.Finish();
+        device.GetQueue().Submit(1, &commands);
+
+        FrameVector<MappedView<uint32_t>> views = MapReadBuffers<uint32_t>(device, requests, 3);
+        if (!views[0] || !views[1] || !views[2])
+        {
+            return false;
+        }
+        uint32_t count = std::min(views[0][0], binSort.Capacity());
+        keys.assign(views[2].begin(), views[2].begin() + count);
+        segmentOffsets.assign(views[1].begin(), views[1].end());
+        return true;
+    }
+
+    void PollFrames()
+    {
+        DeliverCpuFrames();
+        if (!cpuFallback)
+        {
+            TickFrames();
+        }
+    }
+
+    void WaitForFrames()
+    {
+        DeliverCpuFrames();
+        if (cpuFallback)
+        {
+            return;
+        }
+
+        Clock::time_point waitStart = Clock::now();
+        for (const FrameSlot &slot : frameSlots)
+        {
+            while (slot.inFlight)
+            {
+                TickFrames();
+                std::this_thread::sleep_for(std::chrono::microseconds{50});
+            }
+        }
+        frameStats.pipelinedWaitMs += MillisecondsSince(waitStart);
+    }
+
+    uint32_t FramesInFlight()
+    {
+        uint32_t count = static_cast<uint32_t>(cpuFrames.size());
+        for (const FrameSlot &slot : frameSlots)
+        {
+            count += slot.inFlight;
+        }
+        return count;
+    }
+
+    FrameStats GetFrameStats()
+    {
+        FrameStats stats = frameStats;
+        stats.cpuTimeSavedMs = stats.avoidedWaitMs - stats.pipelinedWaitMs;
+        return stats;
+    }
+
+    const char *GetBinningKernelName()
+    {
+        return cpuFallback ? "CpuBinning" : binningLabel;
+    }
+
+    FrameArena &GetFrameArena()
+    {
+        return frameArena;
+    }
+
+    std::vector<PassTiming> GetPassTimings()
+    {
+        return profiler.GetTimings();
     }
 }
@@ -7,12 +7,193 @@
 #include "dawn/native/VulkanBackend.h"
 #include "dawn/dawn_proc.h"
 
+#include "binning.h"
+#include "frame_arena.h"
+#include "path_encoder.h"
+#include "profiler.h"
+
+#ifdef __ANDROID__
 #include <android/native_activity.h>
+#endif
 #include <memory>
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace DawnAndroid {
-    void Init(uint32_t width, uint32_t height);
+    enum class BinningMode {
+        // One shared memory atomicAdd per covered bin per path. The bins of
+        // large paths are spread over the whole workgroup.
+        Atomic,
+        // Row/column path bitmaps per workgroup, no per-bin atomics.
+        Bitmap,
+        // Atomic with one shared memory atomic per subgroup and bin instead
+        // of per lane. Falls back to Atomic without Options::subgroups.
+        Subgroup,
+    };
+
+    struct Options {
+        BinningMode binningMode = BinningMode::Atomic;
+        // Null runs the pipeline without executing anything, which is enough to
+        // exercise it on machines without a GPU.
+        wgpu::BackendType backendType = wgpu::BackendType::Vulkan;
+        // Pick a software adapter (SwiftShader for Vulkan) instead of a GPU.
+        bool forceFallbackAdapter = false;
+        // Directory for Dawn's on-disk shader/pipeline blob cache, disabled when empty.
+        std::string cacheDirectory;
+        // Compile pipelines with CreateComputePipelineAsync and bin on the CPU until they are ready.
+        bool asyncPipelines = true;
+        // Time every compute pass with timestamp queries, if the adapter supports them.
+        bool profiling = false;
+        // Only run the full binning pass after SetPaths(); frames in between
+        // reuse bin_header as patched by UpdatePaths().
+        bool incrementalBinning = false;
+        // Workgroup and tile size the kernels are specialized for.
+        BinningVariant variant;
+        // Time every workgroup size on the first GPU frame after the
+        // caller's first SetPaths() and keep the fastest. The candidates
+        // compile in the background until then. The winner is stored per
+        // adapter in cacheDirectory, so later launches skip the benchmark.
+        bool autoTune = false;
+        // Run the stages after binning in every frame: per-bin path lists
+        // and per-tile path lists for coarse rasterization.
+        bool tiling = false;
+        // Store each path as one u32 of 8-bit tile coordinates instead of a
+        // PathInfo, halving path_info traffic. Ignored when the bin grid is
+        // more than 255 tiles across.
+        bool compactPaths = false;
+        // Threads SetPathGeometry() encodes on, including the caller; 0 uses
+        // every core.
+        uint32_t encoderThreads = 0;
+        // Request chromium_experimental_subgroups when the adapter supports
+        // it, for BinningMode::Subgroup. Auto-tune then also times the
+        // subgroup kernel against the atomic one and keeps the faster.
+        bool subgroups = true;
+        // Build per-bin path lists in every frame by radix sorting one
+        // (bin, path) key per covered bin on the GPU, see GpuRadixSort.
+        // Ignored for scenes of more than 2^kBinKeyShift paths.
+        bool sortedBinLists = false;
+        // Drop paths that cover no bin, because they are empty or outside the
+        // viewport, in a pass before binning, and bin only the survivors.
+        // bin_header partitions then hold the survivors in scene order and
+        // the remaining partitions are zero; the per-bin totals do not
+        // change. Tile lists still hold scene indices. sortedBinLists sorts
+        // keys of the whole scene and bypasses culling. Ignored with
+        // incrementalBinning.
+        bool cullPaths = false;
+    };
+
+    void Init(uint32_t width, uint32_t height, const Options &options = {});
+    // Replaces the scene; the binning dispatch in Frame() covers all `count` paths.
+    void SetPaths(const PathInfo *paths, uint32_t count);
+    // Zero-copy variant of SetPaths(): fill the returned `count` paths in place,
+    // then call EndPathUpload(). The memory is a mapped staging buffer from a
+    // reused ring, so steady state uploads do not allocate.
+    PathInfo *BeginPathUpload(uint32_t count);
+    void EndPathUpload();
+    // SetPaths() from path geometry: the bounding boxes are computed and
+    // packed on the encoder thread pool, straight into the staging buffer.
+    void SetPathGeometry(const PathPoint *points, const PathGeometry *paths, uint32_t count);
+    // Moves a few paths without re-uploading the scene. The deltas between the
+    // old and new bounding boxes are applied to the existing bin counts, so
+    // the cost scales with `count` rather than the scene. Every edit must
+    // name a distinct path below the current path count, and `oldInfo` must
+    // match what the GPU currently has for it.
+    void UpdatePaths(const PathEdit *edits, uint32_t count);
+    // True once every pipeline registered by Init() has compiled; until then
+    // frames run on the CPU binner. Does not tick the device: Frame() and
+    // SubmitFrame() deliver finished compilations, and compile failed ones
+    // again blocking. Stays false if one of those fails too.
+    bool PipelinesReady();
+    // Milliseconds from Init() to the first completed frame, or -1.
+    double TimeToFirstFrameMs();
+    // Binning pass plus a blocking readback.
     void Frame();
+
+    // Number of frames SubmitFrame() keeps on the GPU before it waits.
+    constexpr uint32_t kMaxFramesInFlight = 3;
+
+    // Bin counts of a completed frame, only valid for the duration of the callback.
+    struct FrameResult {
+        uint64_t frameIndex;
+        const uint32_t *binHeader;
+        uint32_t numPartitions;
+        // List sizes the tiling stages needed, zero unless Options::tiling is
+        // set and the frame ran on the GPU.
+        TilingCounters tiling;
+        // Keys the sorted bin lists needed, zero unless
+        // Options::sortedBinLists is set and the frame ran on the GPU.
+        uint32_t binKeys;
+    };
+    using FrameCallback = std::function<void(const FrameResult &)>;
+
+    // Non-blocking variant of Frame(). Encodes and submits the frame and
+    // returns; `callback` runs from PollFrames() or WaitForFrames() once the
+    // readback has landed, or after binning when frames run on the CPU binner.
+    // Blocks only when kMaxFramesInFlight frames are pending.
+    void SubmitFrame(FrameCallback callback);
+    // Delivers completed frames without waiting.
+    void PollFrames();
+    // Blocks until every submitted frame has been delivered.
+    void WaitForFrames();
+    // Frames submitted but not delivered yet.
+    uint32_t FramesInFlight();
+
+    struct FrameStats {
+        uint64_t blockingFrames;
+        // Time Frame() spent spinning on the GPU.
+        double blockingWaitMs;
+        // Pipelined frames whose readback succeeded; the stats below leave
+        // out failed ones, except for the waits.
+        uint64_t pipelinedFrames;
+        // Time SubmitFrame() and WaitForFrames() spent waiting for a free slot.
+        double pipelinedWaitMs;
+        // Sum of submit to readback latencies of the pipelined frames,
+        // including the time until the app polled.
+        double gpuLatencyMs;
+        // Time Frame() would at least have spun on the pipelined frames:
+        // each counts from its submit to the last tick that still found it
+        // in flight.
+        double avoidedWaitMs;
+        // avoidedWaitMs minus pipelinedWaitMs.
+        double cpuTimeSavedMs;
+    };
+    FrameStats GetFrameStats();
+
+    // The phases of Frame() as separate blocking steps, for benchmarking.
+    // Blocks until all submitted GPU work has finished.
+    void WaitForIdle();
+    // Submits only the binning pass.
+    void DispatchBinning();
+    // Copies bin_header back; false when frames run on the CPU or the map failed.
+    bool ReadBackBinHeader(std::vector<uint32_t> &binHeader);
+
+    // The radix sort behind Options::sortedBinLists on its own, for
+    // benchmarking. Keys are BinKey() values; false when there is no GPU or
+    // the map failed. `segmentOffsets` receives kNumBins + 1 list starts.
+    bool UploadSortKeys(const uint32_t *keys, uint32_t count);
+    void DispatchSort();
+    bool ReadBackSortedKeys(std::vector<uint32_t> &keys, std::vector<uint32_t> &segmentOffsets);
+
+    // Switches every binning kernel to `variant`, compiling it unless it is
+    // already in the pipeline cache. Results are laid out for the new
+    // workgroup size from the next frame on. False if the variant is unsupported.
+    bool SetBinningVariant(const BinningVariant &variant);
+    BinningVariant GetBinningVariant();
+    // Kernel in use: "AtomicBinning", "SubgroupBinning", "BitmapBinning" or "CpuBinning".
+    const char *GetBinningKernelName();
+    // Benchmarks the workgroup sizes on the current scene, switches to the
+    // fastest and stores it for Options::autoTune. Blocks for the duration.
+    BinningVariant AutoTuneBinning();
+
+    // Scratch memory for per-frame host data, e.g. from frame callbacks.
+    // Frame() and SubmitFrame() reset it when they start, so allocations
+    // live until the next frame; GetStats() reports the peak.
+    FrameArena &GetFrameArena();
+
+    // Rolling per-pass GPU durations; empty unless Options::profiling is set
+    // and the adapter supports timestamp queries.
+    std::vector<PassTiming> GetPassTimings();
 };
 
 #endif // define __DAWN_ANDROID_LIB_H
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "path_encoder.h"
+
+#include <cmath>
+
+namespace DawnAndroid
+{
+    void EncodePathRange(const PathPoint *points, const PathGeometry *paths, uint32_t begin, uint32_t end,
+                         uint32_t width, uint32_t height, uint32_t tileSize, PathInfo *out)
+    {
+        float maxX = static_cast<float>(DivUp(width, tileSize));
+        float maxY = static_cast<float>(DivUp(height, tileSize));
+        float scale = 1.0f / tileSize;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const PathGeometry &path = paths[i];
+            if (path.pointCount == 0)
+            {
+                out[i] = {0, 0};
+                continue;
+            }
+
+            const PathPoint *p = points + path.firstPoint;
+            float x0 = p[0].x, y0 = p[0].y, x1 = p[0].x, y1 = p[0].y;
+            for (uint32_t j = 1; j < path.pointCount; j++)
+            {
+                x0 = std::min(x0, p[j].x);
+                y0 = std::min(y0, p[j].y);
+                x1 = std::max(x1, p[j].x);
+                y1 = std::max(y1, p[j].y);
+            }
+
+            uint32_t l = static_cast<uint32_t>(std::clamp(std::floor(x0 * scale), 0.0f, maxX));
+            uint32_t t = static_cast<uint32_t>(std::clamp(std::floor(y0 * scale), 0.0f, maxY));
+            uint32_t r = static_cast<uint32_t>(std::clamp(std::ceil(x1 * scale), 0.0f, maxX));
+            uint32_t b = static_cast<uint32_t>(std::clamp(std::ceil(y1 * scale), 0.0f, maxY));
+            out[i] = {(t << 16) | l, (b << 16) | r};
+        }
+    }
+
+    void EncodePaths(ThreadPool &pool, const PathPoint *points, const PathGeometry *paths, uint32_t count,
+                     uint32_t width, uint32_t height, uint32_t tileSize, PathInfo *out)
+    {
+        pool.ParallelFor(count, kEncodeGrain, [&](uint32_t begin, uint32_t end)
+                         { EncodePathRange(points, paths, begin, end, width, height, tileSize, out); });
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef __DAWN_ANDROID_PATH_ENCODER_H
+#define __DAWN_ANDROID_PATH_ENCODER_H
+
+#include "binning.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+
+namespace DawnAndroid
+{
+    struct PathPoint
+    {
+        float x;
+        float y;
+    };
+
+    // Points [firstPoint, firstPoint + pointCount) of a shared array, in pixels.
+    struct PathGeometry
+    {
+        uint32_t firstPoint;
+        uint32_t pointCount;
+    };
+
+    // Paths per ParallelFor() chunk: large enough to amortize the deque
+    // operations, small enough that a scene splits into many more chunks
+    // than there are cores.
+    constexpr uint32_t kEncodeGrain = 2048;
+
+    // Writes the PathInfo of paths [begin, end) to out[begin, end): the
+    // bounding box of the points in tiles of `tileSize` pixels, rounded
+    // outwards and clamped to the viewport. Paths without points are empty.
+    void EncodePathRange(const PathPoint *points, const PathGeometry *paths, uint32_t begin, uint32_t end,
+                         uint32_t width, uint32_t height, uint32_t tileSize, PathInfo *out);
+
+    // EncodePathRange() over all `count` paths in parallel chunks on `pool`.
+    // `out` may be mapped memory; every element is written exactly once, in order within a chunk.
+    void EncodePaths(ThreadPool &pool, const PathPoint *points, const PathGeometry *paths, uint32_t count,
+                     uint32_t width, uint32_t height, uint32_t tileSize, PathInfo *out);
+}
+
+#endif // define __DAWN_ANDROID_PATH_ENCODER_H
@@ -0,0 +1,355 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "pipeline_cache.h"
+#include "lib.h"
+#include "util.h"
+#include "helpers.h"
+
+namespace DawnAndroid
+{
+    // 64-bit FNV-1a, stable across runs unlike std::hash.
+    static uint64_t HashBytes(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    FileCachingInterface::FileCachingInterface(std::string directory) : mDirectory(std::move(directory))
+    {
+    }
+
+    std::string FileCachingInterface::PathForKey(const void *key, size_t keySize) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.blob", static_cast<unsigned long long>(HashBytes(key, keySize)));
+        return mDirectory + name;
+    }
+
+    // File layout: u64 key size, key bytes, value bytes. The key is stored so
+    // that hash collisions read as misses.
+    size_t FileCachingInterface::LoadData(const void *key, size_t keySize, void *value, size_t valueSize)
+    {
+        FILE *file = fopen(PathForKey(key, keySize).c_str(), "rb");
+        if (file == nullptr)
+        {
+            mMisses++;
+            return 0;
+        }
+
+        size_t result = 0;
+        uint64_t storedKeySize = 0;
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        if (fread(&storedKeySize, sizeof(storedKeySize), 1, file) == 1 && storedKeySize == keySize &&
+            fileSize >= static_cast<long>(sizeof(uint64_t) + keySize))
+        {
+            std::vector<uint8_t> storedKey(keySize);
+            if (fread(storedKey.data(), 1, keySize, file) == keySize && memcmp(storedKey.data(), key, keySize) == 0)
+            {
+                result = fileSize - sizeof(uint64_t) - keySize;
+                // Dawn first asks for the size with a null value.
+                if (value != nullptr)
+                {
+                    result = valueSize >= result && fread(value, 1, result, file) == result ? result : 0;
+                }
+            }
+        }
+        fclose(file);
+
+        if (result > 0 && value != nullptr)
+        {
+            mHits++;
+        }
+        else if (result == 0)
+        {
+            mMisses++;
+        }
+        return result;
+    }
+
+    void FileCachingInterface::StoreData(const void *key, size_t keySize, const void *value, size_t valueSize)
+    {
+        // Write to a temporary file first so a crash never leaves a torn entry behind.
+        std::string path = PathForKey(key, keySize);
+        std::string tmpPath = path + ".tmp";
+        FILE *file = fopen(tmpPath.c_str(), "wb");
+        if (file == nullptr)
+        {
+            LOGE("Failed to open %s for writing\n", tmpPath.c_str());
+            return;
+        }
+
+        uint64_t storedKeySize = keySize;
+        bool ok = fwrite(&storedKeySize, sizeof(storedKeySize), 1, file) == 1 &&
+                  fwrite(key, 1, keySize, file) == keySize &&
+                  fwrite(value, 1, valueSize, file) == valueSize;
+        ok = fclose(file) == 0 && ok;
+
+        if (ok && rename(tmpPath.c_str(), path.c_str()) == 0)
+        {
+            mStores++;
+        }
+        else
+        {
+            remove(tmpPath.c_str());
+        }
+    }
+
+    CachingPlatform::CachingPlatform(std::string directory) : mCache(std::move(directory))
+    {
+    }
+
+    dawn::platform::CachingInterface *CachingPlatform::GetCachingInterface()
+    {
+        return &mCache;
+    }
+
+    void PipelineCache::Init(const wgpu::Device &device, const FileCachingInterface *blobCache)
+    {
+        mDevice = device;
+        mBlobCache = blobCache;
+        mPipelines.clear();
+        mLayouts.clear();
+        mFailed.clear();
+        mUnrecoverable = 0;
+        mStats = {};
+        mPending = 0;
+        mGeneration++;
+    }
+
+    uint32_t PipelineCache::LayoutId(const wgpu::BindGroupLayout &bgl)
+    {
+        for (size_t i = 0; i < mLayouts.size(); i++)
+        {
+            if (mLayouts[i].Get() == bgl.Get())
+            {
+                return static_cast<uint32_t>(i);
+            }
+        }
+        mLayouts.push_back(bgl);
+        return static_cast<uint32_t>(mLayouts.size() - 1);
+    }
+
+    std::shared_ptr<CachedPipeline> PipelineCache::Find(const std::string &key, const std::string &source) const
+    {
+        auto range = mPipelines.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second->source == source)
+            {
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    std::string PipelineCache::MakeKey(const wgpu::BindGroupLayout &bgl, const std::string &source, const char *entryPoint,
+                                       const std::vector<wgpu::ConstantEntry> &constants)
+    {
+        char prefix[48];
+        snprintf(prefix, sizeof(prefix), "%016llx:%u:", static_cast<unsigned long long>(HashBytes(source.data(), source.size())),
+                 LayoutId(bgl));
+        std::string key = std::string(prefix) + entryPoint;
+        for (const wgpu::ConstantEntry &constant : constants)
+        {
+            key += ":" + std::string(constant.key) + "=" + std::to_string(constant.value);
+        }
+        return key;
+    }
+
+    void PipelineCache::RecordCreation(CachedPipeline &entry)
+    {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - entry.start).count();
+
+        // With several compilations in flight a blob hit may belong to a
+        // neighbour, so async warm/cold attribution is approximate.
+        bool warm = mBlobCache && mBlobCache->Hits() > entry.blobHitsAtStart;
+        if (warm)
+        {
+            mStats.warmCreations++;
+            mStats.warmCreateMs += ms;
+        }
+        else
+        {
+            mStats.coldCreations++;
+            mStats.coldCreateMs += ms;
+        }
+        LOGI("Pipeline %s created in %.2f ms (%s)\n", entry.label.c_str(), ms, warm ? "warm" : "cold");
+    }
+
+    wgpu::ComputePipeline PipelineCache::Get(const wgpu::BindGroupLayout &bgl, const std::string &source, const char *entryPoint,
+                                             const std::vector<wgpu::ConstantEntry> &constants, const char *label)
+    {
+        std::string key = MakeKey(bgl, source, entryPoint, constants);
+        if (std::shared_ptr<CachedPipeline> cached = Find(key, source))
+        {
+            const CachedPipeline &entry = *cached;
+            while (!entry.ready && !entry.failed)
+            {
+                mDevice.Tick();
+                std::this_thread::sleep_for(std::chrono::microseconds{50});
+            }
+            if (entry.failed)
+            {
+                RetryFailed();
+            }
+            mStats.memoryHits++;
+            return entry.pipeline;
+        }
+
+        auto entry = std::make_shared<CachedPipeline>();
+        entry->label = label;
+        entry->source = source;
+        entry->start = std::chrono::steady_clock::now();
+        entry->blobHitsAtStart = mBlobCache ? mBlobCache->Hits() : 0;
+        entry->pipeline = CreatePipeline(mDevice, bgl, source, label, entryPoint, constants);
+        entry->ready = true;
+        RecordCreation(*entry);
+
+        mPipelines.emplace(std::move(key), entry);
+        return entry->pipeline;
+    }
+
+    std::shared_ptr<const CachedPipeline> PipelineCache::GetAsync(const wgpu::BindGroupLayout &bgl, const std::string &source, const char *entryPoint,
+                                                                  const std::vector<wgpu::ConstantEntry> &constants, const char *label)
+    {
+        std::string key = MakeKey(bgl, source, entryPoint, constants);
+        if (std::shared_ptr<CachedPipeline> cached = Find(key, source))
+        {
+            mStats.memoryHits++;
+            return cached;
+        }
+
+        auto entry = std::make_shared<CachedPipeline>();
+        entry->label = label;
+        entry->source = source;
+        entry->start = std::chrono::steady_clock::now();
+        entry->blobHitsAtStart = mBlobCache ? mBlobCache->Hits() : 0;
+        mPipelines.emplace(std::move(key), entry);
+        mPending++;
+
+        wgpu::ShaderModule shaderModule = dawn::utils::CreateShaderModule(mDevice, source.c_str());
+        wgpu::PipelineLayout pl = dawn::utils::MakeBasicPipelineLayout(mDevice, &bgl);
+        wgpu::ComputePipelineDescriptor csDesc;
+        csDesc.layout = pl;
+        csDesc.compute.module = shaderModule;
+        csDesc.compute.entryPoint = entryPoint;
+        csDesc.label = label;
+        csDesc.compute.constantCount = constants.size();
+        csDesc.compute.constants = constants.data();
+        Request request = {entry, bgl, entryPoint};
+        for (const wgpu::ConstantEntry &constant : constants)
+        {
+            request.constantKeys.push_back(constant.key);
+            request.constantValues.push_back(constant.value);
+        }
+        mDevice.CreateComputePipelineAsync(&csDesc, OnPipelineCreated, new AsyncCreation{this, mGeneration, std::move(request)});
+        return entry;
+    }
+
+    void PipelineCache::OnPipelineCreated(WGPUCreatePipelineAsyncStatus status, WGPUComputePipeline pipeline, const char *message, void *userdata)
+    {
+        std::unique_ptr<AsyncCreation> creation(static_cast<AsyncCreation *>(userdata));
+        CachedPipeline &entry = *creation->request.entry;
+        PipelineCache &cache = *creation->cache;
+        if (creation->generation != cache.mGeneration)
+        {
+            if (pipeline != nullptr)
+            {
+                wgpuComputePipelineRelease(pipeline);
+            }
+            return;
+        }
+
+        cache.mPending--;
+        if (status != WGPUCreatePipelineAsyncStatus_Success)
+        {
+            LOGE("Failed to create pipeline %s: %s\n", entry.label.c_str(), message);
+            entry.failed = true;
+            cache.mFailed.push_back(std::move(creation->request));
+            return;
+        }
+
+        entry.pipeline = wgpu::ComputePipeline::Acquire(pipeline);
+        entry.ready = true;
+        cache.RecordCreation(entry);
+    }
+
+    struct ErrorScopeResult
+    {
+        bool done = false;
+        WGPUErrorType type = WGPUErrorType_NoError;
+    };
+
+    static void OnErrorScopePopped(WGPUErrorType type, const char *message, void *userdata)
+    {
+        ErrorScopeResult &result = *static_cast<ErrorScopeResult *>(userdata);
+        if (type != WGPUErrorType_NoError)
+        {
+            LOGE("Blocking pipeline creation failed: %s\n", message);
+        }
+        result.type = type;
+        result.done = true;
+    }
+
+    uint32_t PipelineCache::RetryFailed()
+    {
+        uint32_t count = 0;
+        for (const Request &request : mFailed)
+        {
+            std::vector<wgpu::ConstantEntry> constants(request.constantKeys.size());
+            for (size_t i = 0; i < constants.size(); i++)
+            {
+                constants[i].key = request.constantKeys[i].c_str();
+                constants[i].value = request.constantValues[i];
+            }
+
+            CachedPipeline &entry = *request.entry;
+            entry.start = std::chrono::steady_clock::now();
+            entry.blobHitsAtStart = mBlobCache ? mBlobCache->Hits() : 0;
+            mDevice.PushErrorScope(wgpu::ErrorFilter::Validation);
+            wgpu::ComputePipeline pipeline = CreatePipeline(mDevice, request.bgl, entry.source, entry.label.c_str(), request.entryPoint.c_str(), constants);
+            // Waits for the callback without a timeout, so `result` outlives it.
+            ErrorScopeResult result;
+            mDevice.PopErrorScope(OnErrorScopePopped, &result);
+            while (!result.done)
+            {
+                mDevice.Tick();
+                std::this_thread::sleep_for(std::chrono::microseconds{50});
+            }
+
+            // A shader or constant error fails the same way every time; the
+            // entry stays failed so frames keep to the CPU binner.
+            if (result.type != WGPUErrorType_NoError)
+            {
+                mUnrecoverable++;
+                continue;
+            }
+            entry.pipeline = pipeline;
+            entry.failed = false;
+            entry.ready = true;
+            RecordCreation(entry);
+            count++;
+        }
+        mFailed.clear();
+        mStats.retriedCreations += count;
+        return count;
+    }
+
+    void PipelineCache::LogStats() const
+    {
+        LOGI("Pipelines: %u cold in %.2f ms, %u warm in %.2f ms, %u in-process hits, %u retried blocking\n",
+             mStats.coldCreations, mStats.coldCreateMs, mStats.warmCreations, mStats.warmCreateMs, mStats.memoryHits,
+             mStats.retriedCreations);
+    }
+}
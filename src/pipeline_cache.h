@@ -0,0 +1,158 @@
+#ifndef __DAWN_ANDROID_PIPELINE_CACHE_H
+#define __DAWN_ANDROID_PIPELINE_CACHE_H
+
+#include "dawn/webgpu_cpp.h"
+#include "dawn/platform/DawnPlatform.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace DawnAndroid
+{
+    // Backs Dawn's blob cache (Tint output, SPIR-V and VkPipelineCache data)
+    // with one file per key, so the second launch skips shader compilation.
+    // Dawn may call in from its worker threads.
+    class FileCachingInterface : public dawn::platform::CachingInterface
+    {
+    public:
+        explicit FileCachingInterface(std::string directory);
+
+        size_t LoadData(const void *key, size_t keySize, void *value, size_t valueSize) override;
+        void StoreData(const void *key, size_t keySize, const void *value, size_t valueSize) override;
+
+        uint64_t Hits() const { return mHits; }
+        uint64_t Misses() const { return mMisses; }
+        uint64_t Stores() const { return mStores; }
+
+    private:
+        std::string PathForKey(const void *key, size_t keySize) const;
+
+        std::string mDirectory;
+        std::atomic<uint64_t> mHits = {0};
+        std::atomic<uint64_t> mMisses = {0};
+        std::atomic<uint64_t> mStores = {0};
+    };
+
+    class CachingPlatform : public dawn::platform::Platform
+    {
+    public:
+        explicit CachingPlatform(std::string directory);
+
+        dawn::platform::CachingInterface *GetCachingInterface() override;
+        const FileCachingInterface &Cache() const { return mCache; }
+
+    private:
+        FileCachingInterface mCache;
+    };
+
+    struct PipelineCacheStats
+    {
+        // Pipelines returned from the in-process cache.
+        uint32_t memoryHits = 0;
+        // Pipelines compiled with a blob cache hit, i.e. without Tint/SPIR-V compilation.
+        uint32_t warmCreations = 0;
+        // Pipelines compiled from scratch.
+        uint32_t coldCreations = 0;
+        double warmCreateMs = 0;
+        double coldCreateMs = 0;
+        // Asynchronous creations that failed and were compiled again blocking
+        // without an error.
+        uint32_t retriedCreations = 0;
+    };
+
+    // A pipeline that may still be compiling. `pipeline` is set once `ready`.
+    struct CachedPipeline
+    {
+        wgpu::ComputePipeline pipeline;
+        bool ready = false;
+        bool failed = false;
+        std::string label;
+        // Full source, compared on every hit so a key hash collision is a miss.
+        std::string source;
+        std::chrono::steady_clock::time_point start;
+        uint64_t blobHitsAtStart = 0;
+    };
+
+    // In-process compute pipeline cache keyed by shader source hash, entry
+    // point, override constants and layout. Layouts are identified by the
+    // order in which the cache first saw them, not by address.
+    class PipelineCache
+    {
+    public:
+        // `blobCache` is optional and only used to tell cold from warm creations.
+        void Init(const wgpu::Device &device, const FileCachingInterface *blobCache);
+
+        // Blocks until the pipeline exists, including one that is compiling asynchronously.
+        wgpu::ComputePipeline Get(const wgpu::BindGroupLayout &bgl, const std::string &source, const char *entryPoint,
+                                  const std::vector<wgpu::ConstantEntry> &constants, const char *label);
+
+        // Starts compiling through CreateComputePipelineAsync and returns
+        // immediately. The entry becomes ready from within device.Tick().
+        std::shared_ptr<const CachedPipeline> GetAsync(const wgpu::BindGroupLayout &bgl, const std::string &source, const char *entryPoint,
+                                                       const std::vector<wgpu::ConstantEntry> &constants, const char *label);
+
+        // True when no asynchronous compilation is outstanding. A failed one
+        // is not outstanding, but its entry stays not ready until RetryFailed().
+        bool AllReady() const { return mPending == 0; }
+        // Asynchronous compilations outstanding.
+        uint32_t PendingCount() const { return mPending; }
+        // True while any entry is failed, whether RetryFailed() has yet to
+        // see it or could not recover it.
+        bool AnyFailed() const { return !mFailed.empty() || mUnrecoverable > 0; }
+        bool RetryPending() const { return !mFailed.empty(); }
+        // Compiles every failed asynchronous creation again, blocking, into
+        // its existing entry. An entry only becomes ready when the creation
+        // raises no validation error; otherwise it stays failed for good.
+        // Returns how many recovered.
+        uint32_t RetryFailed();
+
+        const PipelineCacheStats &Stats() const { return mStats; }
+        void LogStats() const;
+
+    private:
+        // What GetAsync() needs to compile an entry again.
+        struct Request
+        {
+            std::shared_ptr<CachedPipeline> entry;
+            wgpu::BindGroupLayout bgl;
+            std::string entryPoint;
+            std::vector<std::string> constantKeys;
+            std::vector<double> constantValues;
+        };
+
+        struct AsyncCreation
+        {
+            PipelineCache *cache;
+            uint32_t generation;
+            Request request;
+        };
+
+        uint32_t LayoutId(const wgpu::BindGroupLayout &bgl);
+        std::shared_ptr<CachedPipeline> Find(const std::string &key, const std::string &source) const;
+        std::string MakeKey(const wgpu::BindGroupLayout &bgl, const std::string &source, const char *entryPoint,
+                            const std::vector<wgpu::ConstantEntry> &constants);
+        void RecordCreation(CachedPipeline &entry);
+        static void OnPipelineCreated(WGPUCreatePipelineAsyncStatus status, WGPUComputePipeline pipeline, const char *message, void *userdata);
+
+        wgpu::Device mDevice;
+        const FileCachingInterface *mBlobCache = nullptr;
+        // Sources whose hashes collide share a key, hence the multimap.
+        std::unordered_multimap<std::string, std::shared_ptr<CachedPipeline>> mPipelines;
+        // Held so that a released layout's address cannot be reused for a
+        // different layout while pipelines keyed on it are cached.
+        std::vector<wgpu::BindGroupLayout> mLayouts;
+        std::vector<Request> mFailed;
+        // Entries that failed again in RetryFailed().
+        uint32_t mUnrecoverable = 0;
+        PipelineCacheStats mStats;
+        uint32_t mPending = 0;
+        // Bumped by Init() so callbacks from a previous device are ignored.
+        uint32_t mGeneration = 0;
+    };
+}
+
+#endif // define __DAWN_ANDROID_PIPELINE_CACHE_H
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <memory>
+
+#include "profiler.h"
+#include "lib.h"
+#include "util.h"
+#include "helpers.h"
+
+namespace DawnAndroid
+{
+    void GpuProfiler::Init(const wgpu::Device &device, ReadbackPool *pool, bool enabled)
+    {
+        mDevice = device;
+        mPool = pool;
+        mEnabled = enabled;
+        mFramePasses.clear();
+        mSamples.clear();
+        mQuerySet = nullptr;
+        mResolveBuffer = nullptr;
+        if (!mEnabled)
+        {
+            return;
+        }
+
+        wgpu::QuerySetDescriptor querySetDesc;
+        querySetDesc.type = wgpu::QueryType::Timestamp;
+        querySetDesc.count = kMaxPasses * 2;
+        querySetDesc.label = "PassTimestamps";
+        mQuerySet = device.CreateQuerySet(&querySetDesc);
+
+        wgpu::BufferDescriptor bufferDesc;
+        bufferDesc.size = kMaxPasses * 2 * sizeof(uint64_t);
+        bufferDesc.usage = wgpu::BufferUsage::QueryResolve | wgpu::BufferUsage::CopySrc;
+        bufferDesc.label = "PassTimestampResolve";
+        mResolveBuffer = device.CreateBuffer(&bufferDesc);
+    }
+
+    const wgpu::ComputePassTimestampWrites *GpuProfiler::BeginPass(const char *name)
+    {
+        if (!mEnabled || mFramePasses.size() == kMaxPasses)
+        {
+            return nullptr;
+        }
+
+        uint32_t index = mFramePasses.size() * 2;
+        mFramePasses.push_back(name);
+        mWrites.querySet = mQuerySet;
+        mWrites.beginningOfPassWriteIndex = index;
+        mWrites.endOfPassWriteIndex = index + 1;
+        return &mWrites;
+    }
+
+    void GpuProfiler::ResolveFrame(wgpu::CommandEncoder &encoder)
+    {
+        if (!mEnabled || mFramePasses.empty())
+        {
+            return;
+        }
+
+        uint32_t queryCount = mFramePasses.size() * 2;
+        encoder.ResolveQuerySet(mQuerySet, 0, queryCount, mResolveBuffer, 0);
+        wgpu::Buffer readback = mPool->RecordCopy(encoder, mResolveBuffer, queryCount * sizeof(uint64_t));
+
+        delete mResolvedFrame;
+        mResolvedFrame = new PendingFrame{this, std::move(readback), std::move(mFramePasses)};
+        mFramePasses.clear();
+    }
+
+    void GpuProfiler::EndFrame()
+    {
+        if (mResolvedFrame == nullptr)
+        {
+            return;
+        }
+
+        PendingFrame *frame = mResolvedFrame;
+        mResolvedFrame = nullptr;
+        frame->readback.MapAsync(wgpu::MapMode::Read, 0, frame->passes.size() * 2 * sizeof(uint64_t), OnReadback, frame);
+    }
+
+    void GpuProfiler::OnReadback(WGPUBufferMapAsyncStatus status, void *userdata)
+    {
+        std::unique_ptr<PendingFrame> frame(static_cast<PendingFrame *>(userdata));
+        GpuProfiler &profiler = *frame->profiler;
+        if (status != WGPUBufferMapAsyncStatus_Success)
+        {
+            return;
+        }
+
+        const uint64_t *timestamps = static_cast<const uint64_t *>(
+            frame->readback.GetConstMappedRange(0, frame->passes.size() * 2 * sizeof(uint64_t)));
+        for (size_t i = 0; i < frame->passes.size(); i++)
+        {
+            // Dawn reports timestamps in nanoseconds. Drop samples where the
+            // counter went backwards, e.g. across a GPU frequency change.
+            uint64_t begin = timestamps[i * 2];
+            uint64_t end = timestamps[i * 2 + 1];
+            if (end < begin)
+            {
+                continue;
+            }
+
+            std::deque<double> &samples = profiler.mSamples[frame->passes[i]];
+            samples.push_back((end - begin) / 1e6);
+            if (samples.size() > kWindow)
+            {
+                samples.pop_front();
+            }
+        }
+        frame->readback.Unmap();
+        profiler.mPool->Release(std::move(frame->readback));
+    }
+
+    std::vector<PassTiming> GpuProfiler::GetTimings() const
+    {
+        std::vector<PassTiming> timings;
+        for (const auto &[name, samples] : mSamples)
+        {
+            if (samples.empty())
+            {
+                continue;
+            }
+
+            std::vector<double> sorted(samples.begin(), samples.end());
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0;
+            for (double sample : sorted)
+            {
+                sum += sample;
+            }
+
+            PassTiming timing;
+            timing.name = name;
+            timing.samples = sorted.size();
+            timing.minMs = sorted.front();
+            timing.avgMs = sum / sorted.size();
+            timing.p99Ms = sorted[std::min<size_t>(sorted.size() - 1, sorted.size() * 99 / 100)];
+            timings.push_back(timing);
+        }
+        return timings;
+    }
+}
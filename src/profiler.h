@@ -0,0 +1,73 @@
+#ifndef __DAWN_ANDROID_PROFILER_H
+#define __DAWN_ANDROID_PROFILER_H
+
+#include "dawn/webgpu_cpp.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+class ReadbackPool;
+
+namespace DawnAndroid
+{
+    // Rolling GPU duration statistics of one compute pass.
+    struct PassTiming
+    {
+        std::string name;
+        uint32_t samples;
+        double minMs;
+        double avgMs;
+        double p99Ms;
+    };
+
+    // Writes a timestamp at the start and end of every compute pass it is asked
+    // for, resolves them into a reused query buffer and reads them back
+    // alongside the frame. Everything is a no-op when the adapter lacks
+    // wgpu::FeatureName::TimestampQuery.
+    class GpuProfiler
+    {
+    public:
+        static constexpr uint32_t kMaxPasses = 16;
+        // Number of frames the rolling statistics cover.
+        static constexpr uint32_t kWindow = 256;
+
+        void Init(const wgpu::Device &device, ReadbackPool *pool, bool enabled);
+        bool Enabled() const { return mEnabled; }
+
+        // Timestamp writes for the next pass of the current frame, or nullptr
+        // when disabled or out of queries. Valid until the next BeginPass().
+        const wgpu::ComputePassTimestampWrites *BeginPass(const char *name);
+        // Records the resolve and readback copy; call before encoder.Finish().
+        void ResolveFrame(wgpu::CommandEncoder &encoder);
+        // Maps the frame's timestamps; they are folded into the statistics from device.Tick().
+        void EndFrame();
+
+        std::vector<PassTiming> GetTimings() const;
+
+    private:
+        struct PendingFrame
+        {
+            GpuProfiler *profiler;
+            wgpu::Buffer readback;
+            std::vector<std::string> passes;
+        };
+        static void OnReadback(WGPUBufferMapAsyncStatus status, void *userdata);
+
+        wgpu::Device mDevice;
+        ReadbackPool *mPool = nullptr;
+        bool mEnabled = false;
+
+        wgpu::QuerySet mQuerySet;
+        wgpu::Buffer mResolveBuffer;
+        wgpu::ComputePassTimestampWrites mWrites;
+
+        std::vector<std::string> mFramePasses;
+        PendingFrame *mResolvedFrame = nullptr;
+        std::map<std::string, std::deque<double>> mSamples;
+    };
+}
+
+#endif // define __DAWN_ANDROID_PROFILER_H
@@ -0,0 +1,323 @@
+#include "radix_sort.h"
+#include "binning.h"
+
+#include "dawn/utils/WGPUHelpers.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace DawnAndroid
+{
+    // Status words of the look-back: the digit count of a partition alone
+    // (aggregate) or including every earlier partition (prefix), tagged in
+    // the top bits so flag and value are published by one atomic store.
+    static const char *radixSortShader = R"(
+override N_PASSES: u32 = 4u;
+override PASS: u32 = 0u;
+override SEGMENT_SHIFT: u32 = 0u;
+override N_SEGMENTS: u32 = 0u;
+
+const RADIX_BITS: u32 = 8u;
+const RADIX: u32 = 256u;
+const FLAG_AGGREGATE: u32 = 0x40000000u;
+const FLAG_PREFIX: u32 = 0x80000000u;
+const VALUE_MASK: u32 = 0x3fffffffu;
+
+struct SortState {
+    // Keys to sort, clamped to the buffer size.
+    count: u32,
+    // Dynamic partition index of every pass, handed out in launch order so
+    // that look-back only ever waits on workgroups that already run.
+    partitions: array<atomic<u32>, 4>,
+    // Digit counts of every pass, turned into exclusive offsets by scan_main.
+    histograms: array<atomic<u32>, 1024>,
+}
+
+struct DispatchArgs {
+    x: u32,
+    y: u32,
+    z: u32,
+}
+
+@group(0) @binding(0) var<storage, read> key_count: u32;
+@group(0) @binding(1) var<storage, read_write> state: SortState;
+@group(0) @binding(2) var<storage, read_write> args: DispatchArgs;
+@group(0) @binding(3) var<storage, read> keys_in: array<u32>;
+@group(0) @binding(4) var<storage, read_write> keys_out: array<u32>;
+@group(0) @binding(5) var<storage, read_write> status: array<atomic<u32>>;
+@group(0) @binding(6) var<storage, read_write> segment_offsets: array<u32>;
+
+fn digit_of(key: u32, pass_ix: u32) -> u32 {
+    return (key >> (pass_ix * RADIX_BITS)) & (RADIX - 1u);
+}
+
+@compute @workgroup_size(1)
+fn prepare_main() {
+    let count = min(key_count, arrayLength(&keys_in));
+    state.count = count;
+    args = DispatchArgs((count + RADIX - 1u) / RADIX, 1u, 1u);
+}
+
+var<workgroup> sh_histograms: array<atomic<u32>, 1024>;
+
+@compute @workgroup_size(256)
+fn histogram_main(
+    @builtin(global_invocation_id) global_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+) {
+    for (var i = local_id.x; i < N_PASSES * RADIX; i += RADIX) {
+        atomicStore(&sh_histograms[i], 0u);
+    }
+    workgroupBarrier();
+    if global_id.x < state.count {
+        let key = keys_in[global_id.x];
+        for (var p = 0u; p < N_PASSES; p++) {
+            atomicAdd(&sh_histograms[p * RADIX + digit_of(key, p)], 1u);
+        }
+    }
+    workgroupBarrier();
+    for (var i = local_id.x; i < N_PASSES * RADIX; i += RADIX) {
+        let count = atomicLoad(&sh_histograms[i]);
+        if count != 0u {
+            atomicAdd(&state.histograms[i], count);
+        }
+    }
+}
+
+var<workgroup> sh_scan: array<u32, RADIX>;
+
+// Single workgroup.
+@compute @workgroup_size(256)
+fn scan_main(@builtin(local_invocation_id) local_id: vec3<u32>) {
+    for (var p = 0u; p < N_PASSES; p++) {
+        let count = atomicLoad(&state.histograms[p * RADIX + local_id.x]);
+        var sum = count;
+        sh_scan[local_id.x] = sum;
+        for (var i = 1u; i < RADIX; i <<= 1u) {
+            workgroupBarrier();
+            if local_id.x >= i {
+                sum += sh_scan[local_id.x - i];
+            }
+            workgroupBarrier();
+            sh_scan[local_id.x] = sum;
+        }
+        atomicStore(&state.histograms[p * RADIX + local_id.x], sum - count);
+        workgroupBarrier();
+    }
+}
+
+var<workgroup> sh_partition: u32;
+var<workgroup> sh_digits: array<u32, RADIX>;
+var<workgroup> sh_counts: array<atomic<u32>, RADIX>;
+var<workgroup> sh_offsets: array<u32, RADIX>;
+
+@compute @workgroup_size(256)
+fn onesweep_main(@builtin(local_invocation_id) local_id: vec3<u32>) {
+    let lid = local_id.x;
+    if lid == 0u {
+        sh_partition = atomicAdd(&state.partitions[PASS], 1u);
+    }
+    atomicStore(&sh_counts[lid], 0u);
+    let partition = workgroupUniformLoad(&sh_partition);
+
+    let ix = partition * RADIX + lid;
+    let valid = ix < state.count;
+    var key = 0u;
+    var digit = RADIX;
+    if valid {
+        key = keys_in[ix];
+        digit = digit_of(key, PASS);
+        atomicAdd(&sh_counts[digit], 1u);
+    }
+    sh_digits[lid] = digit;
+    workgroupBarrier();
+
+    // Look-back for digit `lid`: publish this partition's count, then add
+    // up earlier partitions until one has published its inclusive prefix.
+    let local_count = atomicLoad(&sh_counts[lid]);
+    var exclusive = 0u;
+    if partition == 0u {
+        atomicStore(&status[lid], FLAG_PREFIX | local_count);
+    } else {
+        atomicStore(&status[partition * RADIX + lid], FLAG_AGGREGATE | local_count);
+        var look = partition - 1u;
+        loop {
+            let word = atomicLoad(&status[look * RADIX + lid]);
+            if (word & (FLAG_AGGREGATE | FLAG_PREFIX)) == 0u {
+                continue;
+            }
+            exclusive += word & VALUE_MASK;
+            if (word & FLAG_PREFIX) != 0u {
+                break;
+            }
+            look -= 1u;
+        }
+        atomicStore(&status[partition * RADIX + lid], FLAG_PREFIX | (exclusive + local_count));
+    }
+    sh_offsets[lid] = atomicLoad(&state.histograms[PASS * RADIX + lid]) + exclusive;
+    workgroupBarrier();
+
+    if valid {
+        // Keys of equal digit keep their order, which makes the sort stable.
+        var rank = 0u;
+        for (var j = 0u; j < lid; j++) {
+            rank += u32(sh_digits[j] == digit);
+        }
+        keys_out[sh_offsets[digit] + rank] = key;
+    }
+}
+
+// Every key that starts a segment writes its index for that segment and
+// any empty segments before it; segment_offsets is cleared beforehand.
+@compute @workgroup_size(256)
+fn segments_main(@builtin(global_invocation_id) global_id: vec3<u32>) {
+    let i = global_id.x;
+    let count = state.count;
+    if i >= count {
+        return;
+    }
+    let segment = min(keys_in[i] >> SEGMENT_SHIFT, N_SEGMENTS);
+    var first = 0u;
+    if i > 0u {
+        first = min(keys_in[i - 1u] >> SEGMENT_SHIFT, N_SEGMENTS) + 1u;
+    }
+    for (var s = first; s <= segment; s++) {
+        segment_offsets[s] = i;
+    }
+    if i == count - 1u {
+        for (var s = segment + 1u; s <= N_SEGMENTS; s++) {
+            segment_offsets[s] = count;
+        }
+    }
+}
+)";
+
+    // SortState in the shader.
+    static constexpr uint64_t kStateSize = (1 + 4 + 4 * GpuRadixSort::kRadix) * sizeof(uint32_t);
+
+    static const char *kPassLabels[] = {"SortPass0", "SortPass1", "SortPass2", "SortPass3"};
+
+    void GpuRadixSort::Init(const wgpu::Device &device, PipelineCache &cache, GpuProfiler *profiler, const Config &config, bool blocking)
+    {
+        mDevice = device;
+        mProfiler = profiler;
+        mConfig = config;
+        mCapacity = 0;
+
+        mBgl = dawn::utils::MakeBindGroupLayout(device, {
+                                                            {0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                            {1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                            {2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                            {3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage},
+                                                            {4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                            {5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                            {6, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage},
+                                                        });
+
+        std::string source = radixSortShader;
+        auto get = [&](const char *entryPoint, const std::vector<wgpu::ConstantEntry> &constants, const char *label)
+        {
+            if (blocking)
+            {
+                cache.Get(mBgl, source, entryPoint, constants, label);
+            }
+            return cache.GetAsync(mBgl, source, entryPoint, constants, label);
+        };
+
+        std::vector<wgpu::ConstantEntry> constants = {
+            {nullptr, "N_PASSES", static_cast<double>(NumPasses())},
+            {nullptr, "SEGMENT_SHIFT", static_cast<double>(config.segmentShift)},
+            {nullptr, "N_SEGMENTS", static_cast<double>(config.numSegments)},
+        };
+        mPreparePipeline = get("prepare_main", {}, "SortPrepare");
+        mHistogramPipeline = get("histogram_main", constants, "SortHistogram");
+        mScanPipeline = get("scan_main", constants, "SortScan");
+        mSegmentsPipeline = get("segments_main", constants, "SortSegments");
+        for (uint32_t pass = 0; pass < NumPasses(); pass++)
+        {
+            mPassPipelines[pass] = get("onesweep_main", {{nullptr, "PASS", static_cast<double>(pass)}}, kPassLabels[pass]);
+        }
+
+        mKeyCount = CreateBuffer(sizeof(uint32_t), wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "SortKeyCount");
+        mState = CreateBuffer(kStateSize, wgpu::BufferUsage::CopyDst, "SortState");
+        mSegmentOffsets = CreateBuffer((config.numSegments + 1) * sizeof(uint32_t), wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "SegmentOffsets");
+        mArgs = CreateBuffer(sizeof(DispatchArgs), wgpu::BufferUsage::CopySrc, "SortArgs");
+
+        wgpu::BufferDescriptor descriptor;
+        descriptor.size = sizeof(DispatchArgs);
+        descriptor.usage = wgpu::BufferUsage::Indirect | wgpu::BufferUsage::CopyDst;
+        descriptor.label = "SortIndirect";
+        mIndirect = device.CreateBuffer(&descriptor);
+    }
+
+    wgpu::Buffer GpuRadixSort::CreateBuffer(uint64_t size, wgpu::BufferUsage usage, const char *label)
+    {
+        wgpu::BufferDescriptor descriptor;
+        descriptor.size = size;
+        descriptor.usage = wgpu::BufferUsage::Storage | usage;
+        descriptor.label = label;
+        return mDevice.CreateBuffer(&descriptor);
+    }
+
+    void GpuRadixSort::Reserve(uint32_t capacity)
+    {
+        if (capacity <= mCapacity)
+        {
+            return;
+        }
+
+        mCapacity = std::max(DivUp(capacity, kPartitionKeys) * kPartitionKeys, mCapacity * 2);
+        mKeys[0] = CreateBuffer(uint64_t(mCapacity) * sizeof(uint32_t), wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "SortKeys");
+        mKeys[1] = CreateBuffer(uint64_t(mCapacity) * sizeof(uint32_t), wgpu::BufferUsage::CopySrc, "SortKeysAlt");
+        // One status word per digit and partition, reused by every pass.
+        mStatus = CreateBuffer(uint64_t(mCapacity / kPartitionKeys) * kRadix * sizeof(uint32_t), wgpu::BufferUsage::CopyDst, "SortStatus");
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            mBindGroups[i] = dawn::utils::MakeBindGroup(mDevice, mBgl, {
+                                                                           {0, mKeyCount},
+                                                                           {1, mState},
+                                                                           {2, mArgs},
+                                                                           {3, mKeys[i]},
+                                                                           {4, mKeys[1 - i]},
+                                                                           {5, mStatus},
+                                                                           {6, mSegmentOffsets},
+                                                                       });
+        }
+    }
+
+    void GpuRadixSort::Encode(wgpu::CommandEncoder &encoder)
+    {
+        auto dispatch = [&](const char *name, const CachedPipeline *pipeline, const wgpu::BindGroup &bindGroup, bool indirect)
+        {
+            wgpu::ComputePassDescriptor descriptor;
+            descriptor.timestampWrites = mProfiler ? mProfiler->BeginPass(name) : nullptr;
+            wgpu::ComputePassEncoder pass = encoder.BeginComputePass(&descriptor);
+            pass.SetPipeline(pipeline->pipeline);
+            pass.SetBindGroup(0, bindGroup);
+            if (indirect)
+            {
+                pass.DispatchWorkgroupsIndirect(mIndirect, 0);
+            }
+            else
+            {
+                pass.DispatchWorkgroups(1);
+            }
+            pass.End();
+        };
+
+        encoder.ClearBuffer(mState);
+        encoder.ClearBuffer(mSegmentOffsets);
+        dispatch("SortPrepare", mPreparePipeline.get(), mBindGroups[0], false);
+        encoder.CopyBufferToBuffer(mArgs, 0, mIndirect, 0, sizeof(DispatchArgs));
+
+        dispatch("SortHistogram", mHistogramPipeline.get(), mBindGroups[0], true);
+        dispatch("SortScan", mScanPipeline.get(), mBindGroups[0], false);
+        for (uint32_t pass = 0; pass < NumPasses(); pass++)
+        {
+            encoder.ClearBuffer(mStatus);
+            dispatch(kPassLabels[pass], mPassPipelines[pass].get(), mBindGroups[pass % 2], true);
+        }
+        dispatch("SortSegments", mSegmentsPipeline.get(), mBindGroups[NumPasses() % 2], true);
+    }
+}
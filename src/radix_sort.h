@@ -0,0 +1,95 @@
+#ifndef __DAWN_ANDROID_RADIX_SORT_H
+#define __DAWN_ANDROID_RADIX_SORT_H
+
+#include "dawn/webgpu_cpp.h"
+
+#include "pipeline_cache.h"
+#include "profiler.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace DawnAndroid
+{
+    // Stable GPU LSD radix sort of u32 keys, 8 bits per pass, plus the
+    // start of every segment (keys >> segmentShift) in the sorted output.
+    //
+    // One histogram pass counts the digits of all passes at once. Every
+    // sort pass is then a single onesweep dispatch: a workgroup ranks its
+    // 256 keys locally and finds their global offsets through a decoupled
+    // look-back over the digit counts of earlier workgroups, so each key is
+    // read and written once per pass.
+    //
+    // The key count is read on the GPU from KeyCount(), so a producer in the
+    // same command buffer can append keys with an atomic counter; it is
+    // clamped to Capacity().
+    class GpuRadixSort
+    {
+    public:
+        static constexpr uint32_t kRadixBits = 8;
+        static constexpr uint32_t kRadix = 1 << kRadixBits;
+        // Keys per workgroup of every pass.
+        static constexpr uint32_t kPartitionKeys = kRadix;
+
+        struct Config
+        {
+            // Significant low bits of the keys; one pass per kRadixBits.
+            uint32_t keyBits = 32;
+            uint32_t segmentShift = 0;
+            uint32_t numSegments = 0;
+        };
+
+        // Compiles through `cache`; with `blocking` false the pipelines are
+        // ready once cache.AllReady().
+        void Init(const wgpu::Device &device, PipelineCache &cache, GpuProfiler *profiler, const Config &config, bool blocking);
+        bool Initialized() const { return mDevice != nullptr; }
+
+        // Grows the key buffers to at least `capacity` keys; invalidates the
+        // buffers returned below.
+        void Reserve(uint32_t capacity);
+        uint32_t Capacity() const { return mCapacity; }
+
+        // Unsorted keys and their count, one u32.
+        const wgpu::Buffer &Keys() const { return mKeys[0]; }
+        const wgpu::Buffer &KeyCount() const { return mKeyCount; }
+
+        // Records the sort; Keys() is used as scratch space.
+        void Encode(wgpu::CommandEncoder &encoder);
+
+        // Results of the last Encode(). SegmentOffsets() holds numSegments + 1
+        // entries: segment s is [offsets[s], offsets[s + 1]).
+        const wgpu::Buffer &SortedKeys() const { return mKeys[NumPasses() % 2]; }
+        const wgpu::Buffer &SegmentOffsets() const { return mSegmentOffsets; }
+
+        uint32_t NumPasses() const { return (mConfig.keyBits + kRadixBits - 1) / kRadixBits; }
+
+    private:
+        wgpu::Buffer CreateBuffer(uint64_t size, wgpu::BufferUsage usage, const char *label);
+
+        wgpu::Device mDevice;
+        GpuProfiler *mProfiler = nullptr;
+        Config mConfig;
+
+        wgpu::BindGroupLayout mBgl;
+        std::shared_ptr<const CachedPipeline> mPreparePipeline;
+        std::shared_ptr<const CachedPipeline> mHistogramPipeline;
+        std::shared_ptr<const CachedPipeline> mScanPipeline;
+        std::shared_ptr<const CachedPipeline> mPassPipelines[32 / kRadixBits];
+        std::shared_ptr<const CachedPipeline> mSegmentsPipeline;
+
+        uint32_t mCapacity = 0;
+        // Ping-pong key buffers; bind group i reads mKeys[i] and writes the other.
+        wgpu::Buffer mKeys[2];
+        wgpu::BindGroup mBindGroups[2];
+        wgpu::Buffer mKeyCount;
+        wgpu::Buffer mState;
+        wgpu::Buffer mStatus;
+        wgpu::Buffer mSegmentOffsets;
+        // The prepare pass writes the dispatch size into mArgs; it is copied
+        // into mIndirect, which cannot be bound for writing in the same pass.
+        wgpu::Buffer mArgs;
+        wgpu::Buffer mIndirect;
+    };
+}
+
+#endif // define __DAWN_ANDROID_RADIX_SORT_H
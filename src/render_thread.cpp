@@ -0,0 +1,168 @@
+#include <chrono>
+
+#include "render_thread.h"
+
+namespace DawnAndroid
+{
+    RenderThread::RenderThread(int64_t frameIntervalNs)
+        : mScheduler(this, frameIntervalNs)
+    {
+    }
+
+    RenderThread::~RenderThread()
+    {
+        Stop();
+    }
+
+    void RenderThread::Start()
+    {
+        mStopping = false;
+        mThread = std::thread(&RenderThread::Run, this);
+    }
+
+    void RenderThread::Stop()
+    {
+        if (!mThread.joinable())
+        {
+            return;
+        }
+        mStopping = true;
+        if (!mWakePending.exchange(true))
+        {
+            mWake.release();
+        }
+        mThread.join();
+    }
+
+    bool RenderThread::Init(uint32_t width, uint32_t height, const Options &options)
+    {
+        Command command;
+        command.type = Command::Type::Init;
+        command.width = width;
+        command.height = height;
+        command.options = options;
+        return Push(std::move(command));
+    }
+
+    bool RenderThread::SetPaths(std::vector<PathInfo> paths)
+    {
+        Command command;
+        command.type = Command::Type::SetPaths;
+        command.paths = std::move(paths);
+        return Push(std::move(command));
+    }
+
+    bool RenderThread::UpdatePaths(std::vector<PathEdit> edits)
+    {
+        Command command;
+        command.type = Command::Type::UpdatePaths;
+        command.edits = std::move(edits);
+        return Push(std::move(command));
+    }
+
+    bool RenderThread::PostInput(const InputEvent &event)
+    {
+        Command command;
+        command.type = Command::Type::Input;
+        command.input = event;
+        return Push(std::move(command));
+    }
+
+    bool RenderThread::SetActive(bool active)
+    {
+        Command command;
+        command.type = Command::Type::SetActive;
+        command.active = active;
+        return Push(std::move(command));
+    }
+
+    bool RenderThread::Push(Command &&command)
+    {
+        if (!mQueue.TryPush(std::move(command)))
+        {
+            return false;
+        }
+        if (!mWakePending.exchange(true))
+        {
+            mWake.release();
+        }
+        return true;
+    }
+
+    int64_t RenderThread::NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool RenderThread::Wait(int64_t timeoutNs)
+    {
+        // Commands queued while the last frame ran must not wait for the timeout.
+        bool woken;
+        if (!mQueue.Empty() || timeoutNs == 0)
+        {
+            woken = mWake.try_acquire();
+        }
+        else if (timeoutNs == kWaitForever)
+        {
+            mWake.acquire();
+            woken = true;
+        }
+        else
+        {
+            woken = mWake.try_acquire_for(std::chrono::nanoseconds(timeoutNs));
+        }
+        // Only after a successful acquire, so there is never more than one release pending.
+        if (woken)
+        {
+            mWakePending = false;
+        }
+
+        DrainCommands();
+        return !mStopping;
+    }
+
+    void RenderThread::Execute(Command &command)
+    {
+        switch (command.type)
+        {
+        case Command::Type::Init:
+            DawnAndroid::Init(command.width, command.height, command.options);
+            break;
+        case Command::Type::SetPaths:
+            DawnAndroid::SetPaths(command.paths.data(), command.paths.size());
+            break;
+        case Command::Type::UpdatePaths:
+            DawnAndroid::UpdatePaths(command.edits.data(), command.edits.size());
+            break;
+        case Command::Type::Input:
+            if (mInputHandler)
+            {
+                mInputHandler(command.input);
+            }
+            break;
+        case Command::Type::SetActive:
+            mScheduler.SetActive(command.active);
+            break;
+        }
+    }
+
+    void RenderThread::DrainCommands()
+    {
+        Command command;
+        while (mQueue.TryPop(command))
+        {
+            Execute(command);
+        }
+    }
+
+    void RenderThread::Run()
+    {
+        mScheduler.SetFrameCallback(mFrameCallback);
+        while (mScheduler.RunOnce())
+        {
+        }
+        // Stop() drains like any other wakeup; only the frames remain.
+        DrainCommands();
+        WaitForFrames();
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef __DAWN_ANDROID_RENDER_THREAD_H
+#define __DAWN_ANDROID_RENDER_THREAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+#include "lib.h"
+#include "frame_scheduler.h"
+#include "spsc_queue.h"
+
+namespace DawnAndroid
+{
+    struct InputEvent
+    {
+        int32_t action;
+        float x;
+        float y;
+    };
+
+    // Owns every DawnAndroid call: Init(), scene updates and the frames of a
+    // FrameScheduler all run on one worker thread. The app thread hands it
+    // commands through an SpscQueue and never waits for the GPU; the render
+    // thread sleeps in SchedulerPlatform::Wait() and wakes for new commands
+    // or frame deadlines.
+    class RenderThread : public SchedulerPlatform
+    {
+    public:
+        static constexpr size_t kQueueCapacity = 256;
+
+        explicit RenderThread(int64_t frameIntervalNs = FrameScheduler::kDefaultFrameIntervalNs);
+        ~RenderThread();
+
+        // Both run on the render thread; set them before Start().
+        void SetFrameCallback(FrameCallback callback) { mFrameCallback = std::move(callback); }
+        void SetInputHandler(std::function<void(const InputEvent &)> handler) { mInputHandler = std::move(handler); }
+
+        void Start();
+        // Finishes the commands queued so far and the frames on the GPU, then joins.
+        void Stop();
+
+        // Commands from the app thread. They never block and return false
+        // when the queue is full, in which case nothing was queued.
+        bool Init(uint32_t width, uint32_t height, const Options &options);
+        bool SetPaths(std::vector<PathInfo> paths);
+        bool UpdatePaths(std::vector<PathEdit> edits);
+        bool PostInput(const InputEvent &event);
+        bool SetActive(bool active);
+
+        // Render thread only, e.g. from the frame callback.
+        SchedulerStats GetSchedulerStats() const { return mScheduler.GetStats(); }
+
+        int64_t NowNs() override;
+        bool Wait(int64_t timeoutNs) override;
+
+    private:
+        struct Command
+        {
+            enum class Type
+            {
+                Init,
+                SetPaths,
+                UpdatePaths,
+                Input,
+                SetActive,
+            };
+            Type type = Type::Input;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            Options options;
+            std::vector<PathInfo> paths;
+            std::vector<PathEdit> edits;
+            InputEvent input = {};
+            bool active = false;
+        };
+
+        bool Push(Command &&command);
+        void Execute(Command &command);
+        void DrainCommands();
+        void Run();
+
+        SpscQueue<Command, kQueueCapacity> mQueue;
+        // Released at most once per wakeup: the producer only releases when it
+        // flips mWakePending, which the render thread clears after acquiring.
+        std::binary_semaphore mWake{0};
+        std::atomic<bool> mWakePending{false};
+        std::atomic<bool> mStopping{false};
+        std::thread mThread;
+
+        FrameScheduler mScheduler;
+        FrameCallback mFrameCallback;
+        std::function<void(const InputEvent &)> mInputHandler;
+    };
+}
+
+#endif // define __DAWN_ANDROID_RENDER_THREAD_H
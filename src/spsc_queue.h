@@ -0,0 +1,73 @@
+#ifndef __DAWN_ANDROID_SPSC_QUEUE_H
+#define __DAWN_ANDROID_SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace DawnAndroid
+{
+    // Bounded lock-free queue for exactly one producer and one consumer
+    // thread. Neither side ever blocks: TryPush() fails when full and
+    // TryPop() when empty. Capacity must be a power of two.
+    template <typename T, size_t Capacity>
+    class SpscQueue
+    {
+        static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        // Producer thread only.
+        bool TryPush(T &&value)
+        {
+            size_t tail = mTail.load(std::memory_order_relaxed);
+            if (tail - mCachedHead == Capacity)
+            {
+                mCachedHead = mHead.load(std::memory_order_acquire);
+                if (tail - mCachedHead == Capacity)
+                {
+                    return false;
+                }
+            }
+            mSlots[tail & (Capacity - 1)] = std::move(value);
+            mTail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer thread only.
+        bool TryPop(T &value)
+        {
+            size_t head = mHead.load(std::memory_order_relaxed);
+            if (head == mCachedTail)
+            {
+                mCachedTail = mTail.load(std::memory_order_acquire);
+                if (head == mCachedTail)
+                {
+                    return false;
+                }
+            }
+            value = std::move(mSlots[head & (Capacity - 1)]);
+            mHead.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Exact on the consumer thread, a snapshot anywhere else.
+        bool Empty() const
+        {
+            return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr size_t kCacheLine = 64;
+
+        std::array<T, Capacity> mSlots;
+        // Each side owns one index plus a cached copy of the other's, so the
+        // shared cache lines are only touched when the cache runs out.
+        alignas(kCacheLine) std::atomic<size_t> mHead{0};
+        size_t mCachedTail = 0;
+        alignas(kCacheLine) std::atomic<size_t> mTail{0};
+        size_t mCachedHead = 0;
+    };
+}
+
+#endif // define __DAWN_ANDROID_SPSC_QUEUE_H
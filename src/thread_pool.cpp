@@ -0,0 +1,139 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+#include "binning.h"
+
+namespace DawnAndroid
+{
+    ThreadPool::ThreadPool(uint32_t threadCount)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        for (uint32_t i = 0; i < threadCount; i++)
+        {
+            mQueues.push_back(std::make_unique<Queue>());
+        }
+        // Queue 0 belongs to the caller of ParallelFor().
+        for (uint32_t i = 1; i < threadCount; i++)
+        {
+            mThreads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mStopping = true;
+        }
+        mWake.notify_all();
+        for (std::thread &thread : mThreads)
+        {
+            thread.join();
+        }
+    }
+
+    void ThreadPool::ParallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)> &fn)
+    {
+        grain = std::max(grain, 1u);
+        if (mThreads.empty() || count <= grain)
+        {
+            if (count > 0)
+            {
+                fn(0, count);
+            }
+            return;
+        }
+
+        mFn = &fn;
+        uint32_t numChunks = DivUp(count, grain);
+        mUnfinished = numChunks;
+
+        // Contiguous runs per thread, so stealing only starts once a thread
+        // has finished its own share.
+        uint32_t numQueues = ThreadCount();
+        uint32_t perQueue = DivUp(numChunks, numQueues);
+        for (uint32_t q = 0; q < numQueues; q++)
+        {
+            std::lock_guard<std::mutex> lock(mQueues[q]->mutex);
+            for (uint32_t c = q * perQueue; c < std::min((q + 1) * perQueue, numChunks); c++)
+            {
+                mQueues[q]->chunks.push_back({c * grain, std::min(count, (c + 1) * grain)});
+            }
+        }
+        {
+            // A worker still draining the previous job may already have
+            // taken some of these, so add rather than store.
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mQueued.fetch_add(numChunks);
+        }
+        mWake.notify_all();
+
+        while (mUnfinished.load(std::memory_order_acquire) > 0)
+        {
+            if (!RunOne(0))
+            {
+                // Only the last chunks are left, running on other threads.
+                std::this_thread::yield();
+            }
+        }
+        mFn = nullptr;
+    }
+
+    bool ThreadPool::RunOne(uint32_t self)
+    {
+        uint32_t numQueues = ThreadCount();
+        Chunk chunk;
+        bool found = false;
+        for (uint32_t i = 0; i < numQueues && !found; i++)
+        {
+            Queue &queue = *mQueues[(self + i) % numQueues];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.chunks.empty())
+            {
+                continue;
+            }
+            if (i == 0)
+            {
+                chunk = queue.chunks.back();
+                queue.chunks.pop_back();
+            }
+            else
+            {
+                chunk = queue.chunks.front();
+                queue.chunks.pop_front();
+            }
+            found = true;
+        }
+        if (!found)
+        {
+            return false;
+        }
+
+        mQueued.fetch_sub(1);
+        (*mFn)(chunk.begin, chunk.end);
+        mUnfinished.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void ThreadPool::WorkerLoop(uint32_t index)
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mSleepMutex);
+                mWake.wait(lock, [this]
+                           { return mStopping || mQueued.load() != 0; });
+                if (mStopping)
+                {
+                    return;
+                }
+            }
+            while (RunOne(index))
+            {
+            }
+        }
+    }
+}
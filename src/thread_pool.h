@@ -0,0 +1,66 @@
+#ifndef __DAWN_ANDROID_THREAD_POOL_H
+#define __DAWN_ANDROID_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DawnAndroid
+{
+    // Fork-join pool for data parallel host work. Every thread, including the
+    // caller of ParallelFor(), has its own chunk deque; it pops from the back
+    // of its own and steals from the front of the others once it runs dry.
+    // With chunks much smaller than count / threads, the fast cores of a
+    // big.LITTLE CPU end up taking the chunks the slow ones have not reached.
+    class ThreadPool
+    {
+    public:
+        // Total threads including the caller; 0 picks one per hardware thread.
+        explicit ThreadPool(uint32_t threadCount = 0);
+        ~ThreadPool();
+
+        uint32_t ThreadCount() const { return static_cast<uint32_t>(mQueues.size()); }
+
+        // Calls fn(begin, end) over [0, count) in chunks of at most `grain`
+        // and returns once all of them ran. Chunks run concurrently and in
+        // any order. Not reentrant; call from one thread at a time.
+        void ParallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)> &fn);
+
+    private:
+        struct Chunk
+        {
+            uint32_t begin;
+            uint32_t end;
+        };
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Chunk> chunks;
+        };
+
+        // Runs one chunk from queue `self`, or stolen from another; false if all are empty.
+        bool RunOne(uint32_t self);
+        void WorkerLoop(uint32_t index);
+
+        std::vector<std::unique_ptr<Queue>> mQueues;
+        std::vector<std::thread> mThreads;
+
+        // Job of the current ParallelFor().
+        const std::function<void(uint32_t, uint32_t)> *mFn = nullptr;
+        // Chunks queued but not taken, and taken but not finished.
+        std::atomic<uint32_t> mQueued{0};
+        std::atomic<uint32_t> mUnfinished{0};
+
+        std::mutex mSleepMutex;
+        std::condition_variable mWake;
+        bool mStopping = false;
+    };
+}
+
+#endif // define __DAWN_ANDROID_THREAD_POOL_H
@@ -36,6 +36,7 @@ samples utility functions
 
 #include "util.h"
 #include "lib.h"
+#include "render_thread.h"
 
 // Android specific include files.
 #include <unordered_map>
@@ -47,6 +48,10 @@ samples utility functions
 // Static variable that keeps ANativeWindow and asset manager instances.
 static android_app *Android_application = nullptr;
 
+// Runs Init() and the frames, so the looper of the main thread only ever
+// waits for lifecycle and input events.
+static DawnAndroid::RenderThread Android_render_thread;
+
 // Helpder class to forward the cout/cerr output to logcat derived from:
 // http://stackoverflow.com/questions/8870174/is-stdcout-usable-in-android-ndk
 class AndroidBuffer : public std::streambuf {
@@ -94,22 +99,16 @@ int32_t Android_handle_input(struct android_app* app, AInputEvent* event) {
                     float x  = AMotionEvent_getXOffset(event);
                     float y  = AMotionEvent_getYOffset(event);
 
-                    printf("Action: %d %f %f\n", action, x, y);
-                    switch(action){
-                        case AMOTION_EVENT_ACTION_DOWN:
-                        break;
-                        case AMOTION_EVENT_ACTION_UP:
-                        break;
-                        case AMOTION_EVENT_ACTION_MOVE:
-                        break;
-                    }
-                break;
+                    // Handled on the render thread; dropped if it is that far behind.
+                    Android_render_thread.PostInput({action, x, y});
+                    return 1;
             } // end switch
         break;
         case AINPUT_EVENT_TYPE_KEY:
             // handle key input...
         break;
     } // end switch
+    return 0;
 }
 
 void Android_handle_cmd(android_app *app, int32_t cmd) {    
@@ -119,35 +118,27 @@ void Android_handle_cmd(android_app *app, int32_t cmd) {
             int32_t w   = ANativeWindow_getWidth(app->window);
             int32_t h   = ANativeWindow_getHeight(app->window);
             
-            DawnAndroid::Init(w, h);
-            DawnAndroid::Frame();
-            LOGI("\n");
-            LOGI("=================================================");
-            LOGI("          The sample ran successfully!!");
-            LOGI("=================================================");
-            LOGI("\n");
+            DawnAndroid::Options options;
+            options.cacheDirectory = app->activity->internalDataPath;
+            Android_render_thread.Init(w, h, options);
+            Android_render_thread.SetActive(true);
             break;
         }
         case APP_CMD_TERM_WINDOW:
             // The window is being hidden or closed, clean it up.
+            Android_render_thread.SetActive(false);
+            break;
+        case APP_CMD_GAINED_FOCUS:
+            Android_render_thread.SetActive(app->window != nullptr);
+            break;
+        case APP_CMD_LOST_FOCUS:
+            Android_render_thread.SetActive(false);
             break;
         default:
             LOGI("event not handled: %d", cmd);
     }
 }
 
-bool Android_process_command() {
-    assert(Android_application != nullptr);
-    int events;
-    android_poll_source *source;
-    // Poll all pending events.
-    if (ALooper_pollAll(0, NULL, &events, (void **)&source) >= 0) {
-        // Process each polled events
-        if (source != NULL) source->process(Android_application, source);
-    }
-    return Android_application->destroyRequested;
-}
-
 void android_main(struct android_app *app) {
     // Set static variables.
     Android_application = app;
@@ -159,11 +150,30 @@ void android_main(struct android_app *app) {
     std::cout.rdbuf(new AndroidBuffer(ANDROID_LOG_INFO));
     std::cerr.rdbuf(new AndroidBuffer(ANDROID_LOG_ERROR));
 
-    // Main loop
-    do {
-        Android_process_command();
-    }  // Check if system requested to quit the application
-    while (app->destroyRequested == 0);
+    Android_render_thread.SetFrameCallback([](const DawnAndroid::FrameResult &result) {
+        if (result.frameIndex == 0) {
+            LOGI("\n");
+            LOGI("=================================================");
+            LOGI("          The sample ran successfully!!");
+            LOGI("=================================================");
+            LOGI("\n");
+        }
+    });
+    Android_render_thread.SetInputHandler([](const DawnAndroid::InputEvent &event) {
+        printf("Action: %d %f %f\n", event.action, event.x, event.y);
+    });
+    Android_render_thread.Start();
+
+    // Main loop, sleeps in the looper until the next event.
+    int events;
+    android_poll_source *source;
+    while (app->destroyRequested == 0) {
+        if (ALooper_pollAll(-1, NULL, &events, (void **)&source) >= 0) {
+            if (source != NULL) source->process(app, source);
+        }
+    }
+
+    Android_render_thread.Stop();
 
     return;
 }
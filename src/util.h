@@ -27,10 +27,14 @@
 #include <sstream>
 #include <vector>
 
-// Include files for Android
 #include <unistd.h>
+#include <cstdio>
+
+#ifdef __ANDROID__
+// Include files for Android
 #include <android/log.h>
 #include <android/native_activity.h>
+#endif
 
 /* Amount of time, in nanoseconds, to wait for a command buffer to complete */
 #define FENCE_TIMEOUT 100000000
@@ -43,14 +47,19 @@
 
 typedef unsigned long long timestamp_t;
 
+#ifdef __ANDROID__
 // Android specific definitions & helpers.
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "DAWN-ANDROID", __VA_ARGS__))
 #define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "DAWN-ANDROID", __VA_ARGS__))
 // Replace printf to logcat output.
 #define printf(...) __android_log_print(ANDROID_LOG_DEBUG, "DAWN-ANDROID", __VA_ARGS__);
 
-bool Android_process_command();
 ANativeWindow* AndroidGetApplicationWindow();
+#else
+// Desktop builds log to stdio.
+#define LOGI(...) ((void)fprintf(stdout, __VA_ARGS__))
+#define LOGE(...) ((void)fprintf(stderr, __VA_ARGS__))
+#endif
 
 // #ifdef __ANDROID__
 // #ifndef VK_API_VERSION_1_0